@@ -0,0 +1,409 @@
+/* Kernel micro-benchmarks.
+
+   Measures the kernel operations in CPU cycles and prints one CSV report:
+
+       benchmark,tasks,depth,samples,min,median,max
+
+   "tasks" is the number of background tasks in the list the operation walks
+   (ReadyList, or TimerList for timerint), "depth" the mailbox capacity.
+   The counter_overhead row is the cost of reading the counter itself and
+   is included in every other row.
+
+   Host:    make -C host bench
+   Target:  build this file instead of main.c with STACK_SIZE=512 (printf
+            runs on a task stack) and semihosting output; the cycles come
+            from the DWT counter through SVC #4.
+
+   Before the report the driver checks that the tick's bottom half wakes
+   a sleeping task, and prints an error instead if it does not.
+
+   Needs KERNEL_CPU_STATS for the tick timestamps of the wait and
+   timerint rows, the job queue (JOB_QUEUE_SIZE > 0) and KERNEL_HANDLERS. */
+#include <stdio.h>
+
+#include "system_sam3x.h"
+#include "kernel_functions.h"
+#include "cycleCounter.h"
+#include "cpuUsage.h"
+
+#if !KERNEL_CPU_STATS
+#error "the kernel benchmarks need KERNEL_CPU_STATS"
+#endif
+
+#if JOB_QUEUE_SIZE == 0 || !KERNEL_HANDLERS
+#error "the kernel benchmarks need the job queue and the handlers"
+#endif
+
+#define SAMPLES         32
+#define MAX_TASKS       32      /* largest background sweep point     */
+#define MAX_DEPTH       16      /* largest mailbox capacity            */
+
+/* Deadlines: the driver always runs first, then the ping-pong partner and
+   short-lived workers, the fillers only when all of them are blocked. */
+#define DL_DRIVER       100000000
+#define DL_PREEMPT      (DL_DRIVER - 1)
+#define DL_PARTNER      (DL_DRIVER + 1)
+#define DL_WORKER       (DL_DRIVER + 2)
+#define DL_FILLER       DEMOTED_DEADLINE
+#define SLEEP_TICKS     50000000
+
+static mailbox *Ping;
+static mailbox *Pong;
+static mailbox *Rpc;
+static handler *Stamper;
+static TCB *Driver;
+static TCB *Notified;
+static volatile uint Stamp[2];
+static volatile int BenchDone = FALSE;
+static volatile int BenchFailed = FALSE;
+static volatile int Woken = FALSE;
+static volatile int YieldDone = FALSE;
+
+static uint Sample[SAMPLES];
+static uint Sample2[SAMPLES];
+static int nFillers = 0;
+static int nSleepers = 0;
+
+static void report(char *name, int nTasks, int nDepth, uint *pSample) {
+    int i, j;
+    uint v;
+    // insertion sort, SAMPLES is small
+    for (i = 1; i < SAMPLES; i++) {
+        v = pSample[i];
+        for (j = i; j > 0 && pSample[j - 1] > v; j--) {
+            pSample[j] = pSample[j - 1];
+        }
+        pSample[j] = v;
+    }
+    printf("%s,%d,%d,%d,%u,%u,%u\n", name, nTasks, nDepth, SAMPLES,
+           pSample[0], pSample[SAMPLES / 2], pSample[SAMPLES - 1]);
+}
+
+static void filler(void) {
+    while (1) {}
+}
+
+static void sleeper(void) {
+    while (1) {
+        wait(SLEEP_TICKS);
+    }
+}
+
+static void worker(void) {
+    terminate();
+}
+
+static void preempter(void) {
+    Stamp[0] = task_cycle_count();
+    Stamp[1] = task_cycle_count();
+    terminate();
+}
+
+static void job_body(void *pArg) {
+    Stamp[0] = task_cycle_count();
+    Stamp[1] = task_cycle_count();
+}
+
+static void stamp_handler(void *pArg) {
+    Stamp[0] = task_cycle_count();
+    Stamp[1] = task_cycle_count();
+}
+
+static void waker(void) {
+    wait(1);
+    Woken = TRUE;
+    terminate();
+}
+
+/* Only the bottom half of the tick wakes tasks, while the top half alone
+   keeps Ticks going (as it does with PendSV at the wrong priority). The
+   driver spins instead of waiting, so that a broken bottom half is
+   reported instead of hanging the benchmarks. */
+static bool bottom_half_runs(void) {
+    uint t0 = ticks();
+    create_task(waker, DL_PREEMPT);
+    while (!Woken && ticks() - t0 < 10) {}
+    return Woken;
+}
+
+/* Shares the driver's deadline and yields back until told to stop */
+static void yielder(void) {
+    while (!YieldDone) {
+        yield();
+    }
+    terminate();
+}
+
+static void notify_partner(void) {
+    uint v;
+    Notified = current_task();
+    while (1) {
+        wait_notification(&v);
+        notify(Driver, v, NOTIFY_OVERWRITE);
+    }
+}
+
+static void rpc_server(void) {
+    int v;
+    receive_wait(Rpc, &v);
+    while (1) {
+        reply_wait(Rpc, &v, &v);
+    }
+}
+
+static void partner(void) {
+    int v;
+    while (1) {
+        receive_wait(Ping, &v);
+        send_wait(Pong, &v);
+    }
+}
+
+/* Ready tasks that never block; they only run while the driver waits */
+static void grow_fillers(int n) {
+    while (nFillers < n) {
+        create_task(filler, DL_FILLER);
+        nFillers++;
+    }
+}
+
+/* Sleeping tasks in the TimerList; they preempt the driver once to call wait() */
+static void grow_sleepers(int n) {
+    while (nSleepers < n) {
+        create_task(sleeper, DL_PREEMPT);
+        nSleepers++;
+    }
+}
+
+static void bench_overhead(void) {
+    int i;
+    uint t0;
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        Sample[i] = task_cycle_count() - t0;
+    }
+    report("counter_overhead", 0, 0, Sample);
+
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        hires_time();
+        Sample[i] = task_cycle_count() - t0;
+    }
+    report("hires_time", 0, 0, Sample);
+}
+
+static void bench_create(int n) {
+    int i;
+    uint t0;
+    // without a switch; the workers terminate during the wait()
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        create_task(worker, DL_WORKER);
+        Sample[i] = task_cycle_count() - t0;
+    }
+    wait(1);
+    report("create_task", n, 0, Sample);
+
+    // with a switch to the new task, then its terminate() back
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        create_task(preempter, DL_PREEMPT);
+        Sample2[i] = task_cycle_count() - Stamp[1];
+        Sample[i] = Stamp[0] - t0;
+    }
+    report("create_task_switch", n, 0, Sample);
+    report("terminate_switch", n, 0, Sample2);
+}
+
+/* The job queue counterpart of bench_create: a job for the idle worker */
+static void bench_job(int n) {
+    int i;
+    uint t0;
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        submit_job(job_body, NULL, DL_PREEMPT);
+        Sample2[i] = task_cycle_count() - Stamp[1];
+        Sample[i] = Stamp[0] - t0;
+    }
+    report("job_switch", n, 0, Sample);
+    report("job_return", n, 0, Sample2);
+}
+
+/* The same for a run-to-completion handler, which runs in the dispatcher */
+static void bench_handler(int n) {
+    int i;
+    uint t0;
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        activate(Stamper);
+        Sample2[i] = task_cycle_count() - Stamp[1];
+        Sample[i] = Stamp[0] - t0;
+    }
+    report("handler_switch", n, 0, Sample);
+    report("handler_return", n, 0, Sample2);
+}
+
+static void bench_pingpong(int n) {
+    int i, v = 0;
+    uint t0, nValue;
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        send_wait(Ping, &v);
+        receive_wait(Pong, &v);
+        Sample[i] = task_cycle_count() - t0;
+    }
+    report("send_receive_wait_rtt", n, 1, Sample);
+
+    // the same round trip with task notifications
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        notify(Notified, i, NOTIFY_OVERWRITE);
+        wait_notification(&nValue);
+        Sample[i] = task_cycle_count() - t0;
+    }
+    report("notify_rtt", n, 0, Sample);
+
+    // and with call() and reply_wait()
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        call(Rpc, &v, &v);
+        Sample[i] = task_cycle_count() - t0;
+    }
+    report("call_rtt", n, 1, Sample);
+}
+
+/* yield() alone, then with a task of the same deadline to take turns with */
+static void bench_yield(int n) {
+    int i;
+    uint t0;
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        yield();
+        Sample[i] = task_cycle_count() - t0;
+    }
+    report("yield_noswitch", n, 0, Sample);
+
+    YieldDone = FALSE;
+    create_task(yielder, DL_DRIVER);
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        yield();
+        Sample[i] = task_cycle_count() - t0;
+    }
+    YieldDone = TRUE;
+    yield();
+    report("yield_rtt", n, 0, Sample);
+}
+
+/* From the start of the tick interrupt to the task running again */
+static void bench_wait(int n) {
+    int i;
+    for (i = 0; i < SAMPLES; i++) {
+        wait(1);
+        Sample[i] = task_cycle_count() - cpu_tick_stamp();
+    }
+    report("wait_wakeup", n, 0, Sample);
+}
+
+/* TimerInt, the top half of the tick, with n sleepers in the TimerList */
+static void bench_timerint(int n) {
+    int i;
+    for (i = 0; i < SAMPLES; i++) {
+        wait(1);
+        Sample[i] = cpu_timerint_cycles();
+    }
+    report("timerint", n, 0, Sample);
+}
+
+static void bench_mailbox(int nDepth) {
+    int i, v = 0;
+    uint t0, t1;
+    mailbox *mBox = create_mailbox(nDepth, sizeof(int));
+    if (mBox == NULL) {
+        return;
+    }
+    for (i = 0; i < nDepth - 1; i++) {
+        send_no_wait(mBox, &v);
+    }
+    for (i = 0; i < SAMPLES; i++) {
+        t0 = task_cycle_count();
+        send_no_wait(mBox, &v);
+        t1 = task_cycle_count();
+        receive_no_wait(mBox, &v);
+        Sample2[i] = task_cycle_count() - t1;
+        Sample[i] = t1 - t0;
+    }
+    report("send_no_wait", 0, nDepth, Sample);
+    report("receive_no_wait", 0, nDepth, Sample2);
+    while (receive_no_wait(mBox, &v) == OK) {}
+    remove_mailbox(mBox);
+}
+
+static void driver(void) {
+    int n;
+
+    Driver = current_task();
+    if (!bottom_half_runs()) {
+        printf("error: the bottom half of the tick does not run\n");
+        BenchFailed = TRUE;
+        while (1) {}
+    }
+    printf("benchmark,tasks,depth,samples,min,median,max\n");
+    bench_overhead();
+    for (n = 1; n <= MAX_TASKS; n *= 2) {
+        grow_fillers(n);
+        bench_create(n);
+        bench_job(n);
+        bench_handler(n);
+        bench_pingpong(n);
+        bench_yield(n);
+        bench_wait(n);
+    }
+    for (n = 1; n <= MAX_DEPTH; n *= 2) {
+        bench_mailbox(n);
+    }
+    // last: the sleepers stay in the TimerList
+    for (n = 1; n <= MAX_TASKS; n *= 2) {
+        grow_sleepers(n);
+        bench_timerint(n);
+    }
+    BenchDone = TRUE;
+    while (1) {
+        wait(SLEEP_TICKS);
+    }
+}
+
+#ifdef KERNEL_HOST
+/* Ends the host run once the report is out */
+int host_tick_hook(void) {
+    if (BenchFailed) {
+        return 1;
+    }
+    return BenchDone ? 0 : -1;
+}
+#endif
+
+int main(void) {
+    SystemInit();
+    SysTick_Config(100000);
+    SCB->SHP[((uint32_t)(SysTick_IRQn) & 0xF)-4] =  (0xE0);
+    isr_off();
+
+    if (init_kernel() != OK) {
+        while (1) {}
+    }
+    Ping = create_mailbox(1, sizeof(int));
+    Pong = create_mailbox(1, sizeof(int));
+    Rpc = create_mailbox(1, sizeof(int));
+    Stamper = create_handler(stamp_handler, NULL, 1);
+    if (Ping == NULL || Pong == NULL || Rpc == NULL || Stamper == NULL ||
+        create_task(driver, DL_DRIVER) != OK ||
+        create_task(partner, DL_PARTNER) != OK ||
+        create_task(notify_partner, DL_PARTNER) != OK ||
+        create_task(rpc_server, DL_PARTNER) != OK ||
+        start_job_workers(1) != OK) {
+        while (1) {}
+    }
+    run();
+    return 0;
+}
@@ -0,0 +1,164 @@
+/* Scheduling policy benchmark.
+
+   Runs one periodic task set under the policy the kernel is built with
+   (KERNEL_POLICY) and prints one CSV row per task:
+
+       policy,task,period,deadline,wcet,jobs,misses,set_deadline_median
+
+   Each job runs for wcet ticks of its own execution and must finish within
+   its relative deadline. "misses" counts the jobs that finished late, and
+   "set_deadline_median" is the median cost in cycles of the set_deadline()
+   at each release, which moves the task to its place in the ReadyList;
+   calls that switched to another task are left out.
+   The set (utilization 0.91) is schedulable under EDF and LLF. Task 1 has
+   a deadline shorter than its period: RM ranks it below task 0 and it
+   misses, DM ranks it first and only task 2 misses.
+
+   Host:    make -C host policies, which runs all four policies on the
+            virtual clock of host_port.c and writes policies.csv
+   Target:  build this file instead of main.c with STACK_SIZE=512 and
+            semihosting output, once per KERNEL_POLICY. */
+#include <stdio.h>
+
+#include "system_sam3x.h"
+#include "kernel_functions.h"
+#include "cycleCounter.h"
+
+#define N_TASKS         3
+#define START           10          /* tick of the first release          */
+#define HYPERPERIODS    10
+#define HYPERPERIOD     700         /* lcm of the periods                  */
+#define END             (START + HYPERPERIODS * HYPERPERIOD)
+#define MAX_JOBS        (HYPERPERIODS * HYPERPERIOD / 50)
+
+typedef struct {
+        uint    nPeriod;
+        uint    nRelDeadline;
+        uint    nWcet;
+        uint    nJobs;
+        uint    nMisses;
+        uint    nSamples;
+        uint    aCost[MAX_JOBS];
+} periodic_task;
+
+static periodic_task TaskSet[N_TASKS] = {
+        {  50, 50, 20 },
+        {  70, 40, 25 },
+        { 100, 100, 15 },
+};
+
+static const char *PolicyName[] = { "EDF", "RM", "DM", "LLF" };
+static volatile int nDone = 0;
+static volatile int BenchDone = FALSE;
+
+#if defined(KERNEL_HOST) && HOST_VIRTUAL_CLOCK
+void host_run_ticks(unsigned int nTicks);
+#endif
+
+/* Busy for nTicks ticks of the caller's own execution */
+static void execute(uint nTicks) {
+#if defined(KERNEL_HOST) && HOST_VIRTUAL_CLOCK
+    host_run_ticks(nTicks);
+#else
+    uint t = ticks();
+    while (nTicks > 0) {
+        if (ticks() != t) {
+            t = ticks();
+            nTicks--;
+        }
+    }
+#endif
+}
+
+static uint median(uint *pSample, uint n) {
+    uint i, j, v;
+    // insertion sort, one report per task
+    for (i = 1; i < n; i++) {
+        v = pSample[i];
+        for (j = i; j > 0 && pSample[j - 1] > v; j--) {
+            pSample[j] = pSample[j - 1];
+        }
+        pSample[j] = v;
+    }
+    return (n > 0) ? pSample[n / 2] : 0;
+}
+
+static void report(void) {
+    int i;
+    periodic_task *p;
+    printf("policy,task,period,deadline,wcet,jobs,misses,set_deadline_median\n");
+    for (i = 0; i < N_TASKS; i++) {
+        p = &TaskSet[i];
+        printf("%s,%d,%u,%u,%u,%u,%u,%u\n", PolicyName[KERNEL_POLICY], i,
+               p->nPeriod, p->nRelDeadline, p->nWcet, p->nJobs, p->nMisses,
+               median(p->aCost, p->nSamples));
+    }
+}
+
+static void run_periodic(periodic_task *p) {
+    uint release = START;
+    uint t0, nTick;
+
+    set_task_params(p->nPeriod, p->nRelDeadline, p->nWcet);
+    wait(START - ticks());
+    while (release < END) {
+        execute(p->nWcet);
+        if (ticks() > release + p->nRelDeadline) {
+            p->nMisses++;
+        }
+        release += p->nPeriod;
+        nTick = ticks();
+        t0 = task_cycle_count();
+        set_deadline(release + p->nRelDeadline);
+        t0 = task_cycle_count() - t0;
+        if (ticks() == nTick && p->nSamples < MAX_JOBS) {
+            p->aCost[p->nSamples++] = t0;
+        }
+        p->nJobs++;
+        if (release > ticks()) {
+            wait(release - ticks());
+        }
+    }
+    if (++nDone == N_TASKS) {
+        report();
+        BenchDone = TRUE;
+    }
+    while (1) {
+        wait(END);
+    }
+}
+
+static void task_0(void) {
+    run_periodic(&TaskSet[0]);
+}
+
+static void task_1(void) {
+    run_periodic(&TaskSet[1]);
+}
+
+static void task_2(void) {
+    run_periodic(&TaskSet[2]);
+}
+
+#ifdef KERNEL_HOST
+/* Ends the host run once the report is out */
+int host_tick_hook(void) {
+    return BenchDone ? 0 : -1;
+}
+#endif
+
+int main(void) {
+    SystemInit();
+    SysTick_Config(100000);
+    SCB->SHP[((uint32_t)(SysTick_IRQn) & 0xF)-4] =  (0xE0);
+    isr_off();
+
+    if (init_kernel() != OK ||
+        create_task(task_0, START + TaskSet[0].nRelDeadline) != OK ||
+        create_task(task_1, START + TaskSet[1].nRelDeadline) != OK ||
+        create_task(task_2, START + TaskSet[2].nRelDeadline) != OK) {
+        while (1) {}
+    }
+    run();
+    return 0;
+}
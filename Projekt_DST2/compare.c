@@ -1,13 +1,20 @@
-#include "kernel_functions.h"
+#include "compare.h"
 
-int cmp_tcb_priority(const void *a, const void *b) {
+int cmp_tcb_deadline(const void *a, const void *b) {
     const TCB *tcb1 = (const TCB *)a;
     const TCB *tcb2 = (const TCB *)b;
     
-    if (tcb1->Deadline < tcb2->Deadline)
+    if (time_before(tcb1->Deadline, tcb2->Deadline))
         return -1;
-    else if (tcb1->Deadline > tcb2->Deadline)
+    else if (time_before(tcb2->Deadline, tcb1->Deadline))
         return 1;
     else
         return 0;
 }
+
+int cmp_tcb_deadline_behind(const void *a, const void *b) {
+    const TCB *tcb1 = (const TCB *)a;
+    const TCB *tcb2 = (const TCB *)b;
+
+    return time_before(tcb1->Deadline, tcb2->Deadline) ? -1 : 1;
+}
@@ -1,6 +1,31 @@
 #ifndef COMPARE_H
 #define COMPARE_H
 
-int cmp_tcb_priority(const void *a, const void *b);
+#include "kernel_functions.h"
+
+/* Tick times wrap around at 2^32, about 60 days at the course's 1.2 ms
+   tick. They are compared modulo 2^32: a is before b if it is less than
+   2^31 ticks behind it, so all times in use must lie within 2^31 ticks of
+   each other. NO_DEADLINE and DEMOTED_DEADLINE are not times and sort
+   after every time; time_valid() moves a computed time off them. */
+static inline bool time_before(uint a, uint b) {
+    if (a >= DEMOTED_DEADLINE || b >= DEMOTED_DEADLINE) {
+        return a < b;
+    }
+    return (int) (a - b) < 0;
+}
+
+/* TRUE once the tick has reached t; never for the two non-times */
+static inline bool time_reached(uint t) {
+    return t < DEMOTED_DEADLINE && (int) (Ticks - t) >= 0;
+}
+
+/* t, or the first time after the wrap if t is one of the non-times */
+static inline uint time_valid(uint t) {
+    return (t >= DEMOTED_DEADLINE) ? 0 : t;
+}
+
+int cmp_tcb_deadline(const void *a, const void *b);
+int cmp_tcb_deadline_behind(const void *a, const void *b);  /* equal sorts after */
 
 #endif
\ No newline at end of file
@@ -5,19 +5,36 @@
         
         MODULE  ?context_switching_functions_march_2019
 
+#include "kernel_config.h"
+
         PUBLIC  SwitchContext
         PUBLIC  LoadContext_In_Run
         PUBLIC  LoadContext_In_Terminate
         PUBLIC  switch_to_stack_of_next_task
 
         PUBLIC  SysTick_Handler
+        PUBLIC  PendSV_Handler
+        PUBLIC  request_bottom_half
         PUBLIC  SVC_Handler
         PUBLIC  isr_on
         PUBLIC  isr_off
+        PUBLIC  read_cycle_counter
+        PUBLIC  kernel_call
+        PUBLIC  critical_enter_svc
+        PUBLIC  critical_exit_svc
         
         EXTERN  NextTask
         EXTERN  PreviousTask
         EXTERN  TimerInt
+        EXTERN  TimerBottomHalf
+        EXTERN  kernel_dispatch
+#if KERNEL_SWITCH_HOOK
+        EXTERN  switch_hook
+#endif
+#if KERNEL_MASK_STATS
+        EXTERN  mask_begin
+        EXTERN  mask_end
+#endif
 
         SECTION .text:CODE
 
@@ -28,9 +45,27 @@ address_ICSR             EQU   0xE000ED04    ; address of the NVIC ICSR register
                                              ; if we write  1 to bit 25 then we clear any pending sys tick interrupt
 address_sysTick_reload   EQU   0xE000E014    ; address of the Sys Tick reload value register
 address_sysTick_counter  EQU   0xE000E018    ; address of the Sys Tick count down counter register
+address_DWT_CYCCNT       EQU   0xE0001004    ; address of the DWT cycle counter
+address_PendSV_priority  EQU   0xE000ED22    ; PendSV byte of the SHPR3 register
+SVC_COUNT                EQU   8             ; number of SVC functions in svc_table
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 SysTick_Handler
+; top half of the tick: constant work, other interrupts stay enabled
+        
+        TST     LR,  #0x04     ; tick while main was executing: nothing to do
+        BEQ     systick_return
+        PUSH    {r0, LR}       ; r0 only keeps the main stack 8 byte aligned
+        BL      TimerInt       ; call Kernel C function TimerInt, which pends
+                               ; PendSV if the bottom half has work
+        POP     {r0, PC}       ; exit ISR and trigger hardware unstacking
+systick_return
+        BX      LR
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+PendSV_Handler
+; bottom half of the tick: list work and the context switch, runs at the
+; priority of Sys Tick once all other interrupts have returned
 
         CPSID   I              ; disable all maskable interrupts
         
@@ -55,10 +90,15 @@ SysTick_Handler
         STMIA   r0, {r4-r11}   ; store r4 through r11
         ISB
         PUSH    {r3, LR}       ; push on main stack the address of RuningTask, and LR
+        CPSIE   I              ; the list work can be interrupted
         
-        BL      TimerInt       ; call Kernel C function TimerInt
+        BL      TimerBottomHalf ; call Kernel C function TimerBottomHalf
                                ; among other things, this might update RunningTask
                                ; (and unfortunately) changes LR 
+        CPSID   I
+#if KERNEL_SWITCH_HOOK
+        BL      switch_hook    ; accounting and tracing, see kernel_config.h
+#endif
         POP     {r3, LR}
         
         ISB       
@@ -91,22 +131,29 @@ SVC_Handler
         B       calculate_SVC_number        
 
 called_from_main
-        MOV     r0, SP          ; peek into main stack
-        LDR     r1, [r0, #40]   ; retrieve hardware stacked PC
+        ADD     r0, SP, #16     ; peek into main stack, above the 4 registers pushed here
+        LDR     r1, [r0, #24]   ; retrieve hardware stacked PC
         
 calculate_SVC_number
         LDRH    r2, [r1, #-2]   ; load half word
         BIC     r2, r2, #0xFF00 ; Extract SVC number
                 
-        CMP     r2, #0
-        BEQ    svc_function_isrOff
-        CMP     r2, #1
-        BEQ    svc_function_isrOn
-        CMP     r2, #2
-        BEQ    svc_function_switchContext
-        CMP     r2, #3
-        BEQ    svc_function_loadContext_for_terminate
+        CMP     r2, #SVC_COUNT
+        BHS     svc_function_unknown
+        TBB     [PC, r2]        ; jump through svc_table, indexed by the SVC number
+svc_table
+        DATA
+        DC8     (svc_function_isrOff - svc_table)/2
+        DC8     (svc_function_isrOn - svc_table)/2
+        DC8     (svc_function_switchContext - svc_table)/2
+        DC8     (svc_function_loadContext_for_terminate - svc_table)/2
+        DC8     (svc_function_readCycleCounter - svc_table)/2
+        DC8     (svc_function_kernelCall - svc_table)/2
+        DC8     (svc_function_criticalEnter - svc_table)/2
+        DC8     (svc_function_criticalExit - svc_table)/2
+        THUMB
         
+svc_function_unknown
 	CPSIE   I               ; for all other SVC numbers
         POP     {r0,r1,r2,PC}   ; exit ISR and trigger_hardware_unstack 
 
@@ -137,29 +184,13 @@ svc_function_switchContext
         STR     r0,  [r1]
         ADD     r1, r1, #4
         STMIA   r1, {r4-r11}    ; this completes context saving for task running before interrupt
-        
-        POP     {r0, r1, r2}    ; to (partly) reverse the PUSH at the beginning of SVC handler
-                                ; exception return value is now at top of main stack
-                                ; and this shall be popped while leaving the ISR
-        
-        LDR     r1,  =NextTask
-        LDR     r1,  [r1]
-        LDR     r0,  [r1]       ; retrieve stored process stack pointer
-        MSR     psp, r0
-        ISB
-        
-        ADD     r1,  r1, #4     ; make r0 point to RunningTask->R4toR11[0]
-        LDMIA   r1, {r4-r11}    ; restore r4 through r11
-        ISB
-                
-        MOV     r0, #0
-        MSR     BASEPRI,  r0    ;  enables all maskable interrupts, including sys tick
-        ISB
-        CPSIE   I
-        POP     {PC}            ; exit ISR and trigger_hardware_unstack 
+                                ; and continues as SVC function 3 to load NextTask
 ;;;----------------------
 svc_function_loadContext_for_terminate        
 ;  SVC function 3
+#if KERNEL_SWITCH_HOOK
+        BL      switch_hook     ; accounting and tracing, see kernel_config.h
+#endif
         POP     {r0, r1, r2}    ; to (partly) reverse the PUSH at the beginning of SVC handler
         
         LDR     r1,  =NextTask
@@ -178,6 +209,84 @@ svc_function_loadContext_for_terminate
         CPSIE   I
         POP     {PC}            ; exit ISR and trigger_hardware_unstack 
         
+;;;----------------------
+svc_function_readCycleCounter
+;  SVC function 4
+        LDR     r1, =address_DWT_CYCCNT
+        LDR     r1, [r1]
+        STR     r1, [r0]        ; r0 points to the hardware stacked frame of the caller:
+                                ; overwrite the stacked r0, the return value
+        CPSIE   I
+        POP     {r0,r1,r2,PC}   ; exit ISR and trigger_hardware_unstack 
+        
+;;;----------------------
+svc_function_kernelCall
+;  SVC function 5
+;  r0 points to the hardware stacked frame of the calling task:
+;  stacked r0 is the kernel call number, stacked r1 and r2 its arguments
+        PUSH    {r0, r4}        ; keep the frame address, 8 byte stack alignment
+        MOV     r3, r0
+        LDR     r0, [r3]
+        LDR     r1, [r3, #4]
+        LDR     r2, [r3, #8]
+        CPSIE   I               ; SVC outranks Sys Tick, so the call stays atomic
+        BL      kernel_dispatch ; call Kernel C function kernel_dispatch
+        CPSID   I
+        POP     {r3, r4}
+        STR     r0, [r3]        ; overwrite the stacked r0, the return value
+        
+        LDR     r1,  =PreviousTask
+        LDR     r1,  [r1]
+        LDR     r2,  =NextTask
+        LDR     r2,  [r2]
+        CMP     r1,  r2
+        BEQ     svc_function_unknown        ; no switch: plain exception return
+        CMP     r1,  #0
+        BEQ     svc_function_loadContext_for_terminate  ; the caller has terminated
+        B       svc_function_switchContext  ; save the caller, load NextTask
+
+;;;----------------------
+svc_function_criticalEnter
+;  SVC function 6
+#if KERNEL_MASK_STATS
+        MRS     r1, BASEPRI
+        CBNZ    r1, critical_enter_body     ; already masked, not a new section
+        PUSH    {r0, r3}        ; keep the frame address, 8 byte stack alignment
+        LDR     r1, [r0, #4]    ; stacked r1, the line of the call site
+        LDR     r0, [r0]        ; stacked r0, the file of the call site
+        BL      mask_begin      ; see maskStats.h
+        POP     {r0, r3}
+critical_enter_body
+#endif
+        MRS     r1, BASEPRI
+        STR     r1, [r0]        ; the previous mask is the return value in stacked r0
+        CBZ     r1, critical_mask           ; unmasked before
+        CMP     r1, #0xA0
+        BLS     svc_function_unknown        ; already masked at least as strictly
+critical_mask
+        MOV     r1, #0xA0       ; same mask as SVC function 0
+        MSR     BASEPRI,  r1
+        CPSIE   I
+        POP     {r0,r1,r2,PC}   ; exit ISR and trigger_hardware_unstack 
+
+;;;----------------------
+svc_function_criticalExit
+;  SVC function 7
+#if KERNEL_MASK_STATS
+        LDR     r1, [r0]
+        CBNZ    r1, critical_exit_body      ; stays masked
+        MRS     r1, BASEPRI
+        CBZ     r1, critical_exit_body      ; was not masked
+        PUSH    {r0, r3}
+        BL      mask_end        ; see maskStats.h
+        POP     {r0, r3}
+critical_exit_body
+#endif
+        LDR     r1, [r0]        ; stacked r0, the mask returned by SVC function 6
+        MSR     BASEPRI,  r1
+        CPSIE   I
+        POP     {r0,r1,r2,PC}   ; exit ISR and trigger_hardware_unstack 
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
 SwitchContext
@@ -212,6 +321,10 @@ LoadContext_In_Run
         
 ;     still in priveleged mode
 
+        LDR      r0,  =address_PendSV_priority
+        MOV      r1,  #0xE0       ; the tick priority: the two halves never preempt each other,
+        STRB     r1,  [r0]        ; and PendSV returns to a task, where it saves the context
+
 ;  -*-start of code section that makes sure that sys tick does not hit on exiting
         LDR      r0, =address_sysTick_reload
         LDR      r1, =address_sysTick_counter
@@ -278,6 +391,15 @@ switch_to_stack_of_next_task
         
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
+request_bottom_half
+; pends PendSV, which runs TimerBottomHalf; handler mode only
+        LDR     r0,  =address_ICSR
+        MOV     r1,  #(1<<28)   ; write 1 at bit 28 in ICSR to set PendSV pending
+        STR     r1,  [r0]
+        BX      LR
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
 isr_on
         PUSH    {LR};
         SVC     #1
@@ -292,6 +414,41 @@ isr_off
         ISB
         POP     {PC}
 
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+read_cycle_counter
+; returns the DWT cycle counter, also in unprivileged mode
+        PUSH    {LR}
+        SVC     #4
+        POP     {PC}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+kernel_call
+; r0 = kernel call number, r1 and r2 = arguments; returns the result in r0
+        PUSH    {LR}
+        SVC     #5
+        POP     {PC}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+critical_enter_svc
+; masks the tick, returns the previous BASEPRI in r0, see critical.h
+; r0 and r1 are the file and line of the call site for KERNEL_MASK_STATS
+        PUSH    {LR}
+        SVC     #6
+        ISB
+        POP     {PC}
+
+;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+
+critical_exit_svc
+; restores BASEPRI from r0
+        PUSH    {LR}
+        SVC     #7
+        ISB
+        POP     {PC}
+
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
         END
\ No newline at end of file
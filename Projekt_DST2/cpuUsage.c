@@ -0,0 +1,107 @@
+#include "cpuUsage.h"
+
+#if KERNEL_CPU_STATS
+
+#include "cycleCounter.h"
+#include "critical.h"
+
+extern TCB *NextTask;
+
+static TCB *Accounted = NULL;           /* task charged for the running slice */
+static uint LastSwitch = 0;             /* cycle count at the last switch     */
+static unsigned long long TotalCycles = 0;
+static uint TickStamp = 0;              /* cycle count at TimerInt entry      */
+static uint TimerIntCycles = 0;         /* duration of the last TimerInt      */
+
+/* Called by run(), still in privileged mode. */
+void cpu_usage_start(void) {
+    cycle_counter_enable();
+    LastSwitch = cycle_count();
+    Accounted = NextTask;
+}
+
+/* Called by terminate() before the TCB is freed; the rest of the slice is
+   only counted in the total. */
+void cpu_usage_forget(TCB *task) {
+    if (Accounted == task) {
+        Accounted = NULL;
+    }
+}
+
+void cpu_account_switch(void) {
+    uint now = cycle_count();
+    uint slice = now - LastSwitch;      // modulo 2^32, correct across wraps
+
+    LastSwitch = now;
+    TotalCycles += slice;
+    if (Accounted != NULL) {
+        Accounted->nCycles += slice;
+    }
+    Accounted = NextTask;
+}
+
+/* Called at the start and the end of TimerInt, in handler mode */
+void cpu_tick_begin(void) {
+    TickStamp = cycle_count();
+}
+
+void cpu_tick_end(void) {
+    TimerIntCycles = cycle_count() - TickStamp;
+}
+
+uint cpu_tick_stamp(void) {
+    return TickStamp;
+}
+
+uint cpu_timerint_cycles(void) {
+    return TimerIntCycles;
+}
+
+static int collect(list *lst, cpu_usage *pUsage, int n, int nMax) {
+    listobj *node = lst->pHead;
+    while (node != NULL && n < nMax) {
+        pUsage[n].pTask = node->pTask;
+        pUsage[n].nCycles = node->pTask->nCycles;
+        pUsage[n].nPermille = (TotalCycles > 0)
+            ? (uint) (node->pTask->nCycles * 1000 / TotalCycles) : 0;
+        n++;
+        node = node->pNext;
+    }
+    return n;
+}
+
+int cpu_usage_snapshot(cpu_usage *pUsage, int nMax) {
+    int n = 0;
+    uint state;
+    if (pUsage == NULL) {
+        return 0;
+    }
+    state = critical_enter();
+    n = collect(ReadyList, pUsage, n, nMax);
+    n = collect(WaitingList, pUsage, n, nMax);
+    n = collect(TimerList, pUsage, n, nMax);
+    critical_exit(state);
+    return n;
+}
+
+/* The idle task has the latest deadline and never blocks, so it is always
+   the tail of the ReadyList. */
+unsigned long long cpu_idle_cycles(void) {
+    unsigned long long nCycles;
+    uint state;
+    state = critical_enter();
+    nCycles = ReadyList->pTail->pTask->nCycles;
+    critical_exit(state);
+    return nCycles;
+}
+
+unsigned long long cpu_total_cycles(void) {
+    unsigned long long nCycles;
+    uint state;
+    state = critical_enter();
+    nCycles = TotalCycles;
+    critical_exit(state);
+    return nCycles;
+}
+
+#endif
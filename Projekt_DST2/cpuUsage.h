@@ -0,0 +1,52 @@
+#ifndef CPUUSAGE_H
+#define CPUUSAGE_H
+
+#include "kernel_functions.h"
+
+/* Per-task CPU time accounting.
+   switch_hook() calls cpu_account_switch() in handler mode on every switch
+   and every run of the tick's bottom half, which follows only the ticks
+   with work for it; it charges the cycles since the previous call to the
+   task that was running. With KERNEL_CPU_STATS set to 0 none of this is
+   compiled. */
+
+#if KERNEL_CPU_STATS
+
+// Utilization of one task
+typedef struct {
+        TCB                     *pTask;
+        unsigned long long      nCycles;    /* cycles run since run()          */
+        uint                    nPermille;  /* share of all cycles, 0 to 1000  */
+} cpu_usage;
+
+/* Fills pUsage with up to nMax entries, one per existing task including the
+   idle task. Returns the number of entries written. */
+int                     cpu_usage_snapshot( cpu_usage *pUsage, int nMax );
+
+/* Cycles spent in the idle task, and in all tasks together (including
+   tasks that have since terminated). */
+unsigned long long      cpu_idle_cycles( void );
+unsigned long long      cpu_total_cycles( void );
+
+/* Cycle count at the start of the last TimerInt, and the cycles it took */
+uint                    cpu_tick_stamp( void );
+uint                    cpu_timerint_cycles( void );
+
+// Kernel internal
+void                    cpu_usage_start( void );
+void                    cpu_usage_forget( TCB *task );
+void                    cpu_account_switch( void );
+void                    cpu_tick_begin( void );
+void                    cpu_tick_end( void );
+
+#else
+
+#define cpu_usage_start()
+#define cpu_usage_forget(task)
+#define cpu_account_switch()
+#define cpu_tick_begin()
+#define cpu_tick_end()
+
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef CRITICAL_H
+#define CRITICAL_H
+
+#include "kernel_functions.h"
+#include "maskStats.h"
+
+/* Nestable critical sections.
+   critical_enter() masks the tick and returns the previous mask state and
+   critical_exit() restores it, so code holding a critical section can call
+   helpers that take their own:
+
+       uint state = critical_enter();
+       ...
+       critical_exit(state);
+
+   Privileged code (exception handlers, main() before run()) writes BASEPRI
+   inline. Tasks run unprivileged and trap with SVC #6 and #7. Unlike
+   isr_off() and isr_on() these never unmask a caller's critical section.
+   With KERNEL_MASK_STATS the masked time is charged to the call site.
+
+   The mask also holds off every interrupt handler whose priority value is
+   CRITICAL_BASEPRI or more, and only those may call the kernel (notify(),
+   submit_job(), activate()): 0xA0 to 0xD0 next to Sys Tick and PendSV at
+   0xE0. The kernel calls of interrupt handlers and the tick's bottom half
+   run in a critical section, so they do not interleave with each other's
+   list work. Interrupt handlers at 0x00 to 0x90 are never masked and must
+   not call the kernel. */
+
+#define CRITICAL_BASEPRI        0xA0    /* masks Sys Tick, priority 0xE0 */
+
+#if KERNEL_MASK_STATS
+#define critical_enter()        critical_enter_at(__FILE__, __LINE__)
+#else
+#define critical_enter()        critical_enter_at(0, 0)
+#endif
+
+#ifdef KERNEL_HOST
+
+extern uint             host_critical_enter( void );
+extern void             host_critical_exit( uint state );
+
+static inline uint critical_enter_at(const char *pFile, int nLine) {
+    uint state = host_critical_enter();
+    if (state == 0) {
+        mask_begin(pFile, nLine);
+    }
+    return state;
+}
+
+static inline void critical_exit(uint state) {
+    if (state == 0) {
+        mask_end();
+    }
+    host_critical_exit(state);
+}
+
+#else
+
+#include "system_sam3x.h"    /* for __get_BASEPRI, __get_CONTROL */
+
+extern uint             critical_enter_svc( const char *pFile, int nLine ); /* SVC #6 */
+extern void             critical_exit_svc( uint state );        /* SVC #7 */
+
+/* Handler mode, or thread mode with CONTROL.nPRIV clear */
+static inline int privileged(void) {
+    return __get_IPSR() != 0 || (__get_CONTROL() & 1) == 0;
+}
+
+static inline uint critical_enter_at(const char *pFile, int nLine) {
+    uint state;
+    if (!privileged()) {
+        return critical_enter_svc(pFile, nLine);
+    }
+    state = __get_BASEPRI();
+    if (state == 0) {
+        mask_begin(pFile, nLine);
+    }
+    if (state == 0 || state > CRITICAL_BASEPRI) {
+        __set_BASEPRI(CRITICAL_BASEPRI);    // never lower a stricter mask
+    }
+    return state;
+}
+
+static inline void critical_exit(uint state) {
+    if (!privileged()) {
+        critical_exit_svc(state);
+        return;
+    }
+    if (state == 0 && __get_BASEPRI() != 0) {
+        mask_end();
+    }
+    __set_BASEPRI(state);
+}
+
+#endif
+
+#endif
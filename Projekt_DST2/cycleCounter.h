@@ -0,0 +1,102 @@
+#ifndef CYCLECOUNTER_H
+#define CYCLECOUNTER_H
+
+#ifdef KERNEL_HOST
+
+/* Host port: the counters are emulated by host/host_port.c. cycle_count()
+   reads the host's time stamp counter and systick_count() the host cycles
+   left until the next virtual tick. */
+
+unsigned int    host_cycle_count( void );
+unsigned int    host_systick_count( void );
+unsigned int    host_systick_reload( void );
+int             host_handler_mode( void );
+
+static inline void cycle_counter_enable(void) {
+}
+
+static inline unsigned int cycle_count(void) {
+    return host_cycle_count();
+}
+
+static inline unsigned int systick_reload(void) {
+    return host_systick_reload();
+}
+
+static inline unsigned int systick_count(void) {
+    return host_systick_count();
+}
+
+/* The emulated counter stops at 0 until the tick runs, so it never wraps
+   ahead of a pending tick */
+static inline int systick_pending(void) {
+    return 0;
+}
+
+static inline int handler_mode(void) {
+    return host_handler_mode();
+}
+
+static inline unsigned int task_cycle_count(void) {
+    return host_cycle_count();
+}
+
+#else
+
+#include "system_sam3x.h"    /* for __get_IPSR */
+
+/* Cortex-M3 DWT cycle counter, counts core clock cycles (84 MHz on the Due),
+   and the SysTick down counter. The registers are on the private peripheral
+   bus and can only be accessed in privileged mode, i.e. from main() before
+   run() or from an exception handler. */
+
+#define address_DEMCR            0xE000EDFC  /* Debug Exception and Monitor Control */
+#define address_DWT_CTRL         0xE0001000
+#define address_DWT_CYCCNT       0xE0001004
+#define address_sysTick_reload   0xE000E014  /* cycles per tick - 1 */
+#define address_sysTick_counter  0xE000E018  /* counts down to 0 each tick */
+#define address_ICSR             0xE000ED04  /* interrupt control and state */
+
+#define DEMCR_TRCENA             (1u << 24)  /* enables the DWT unit */
+#define DWT_CTRL_CYCCNTENA       (1u << 0)
+#define ICSR_PENDSTSET           (1u << 26)  /* SysTick exception pending */
+
+#define REG(address)             (*(volatile unsigned int *) (address))
+
+static inline void cycle_counter_enable(void) {
+    REG(address_DEMCR) |= DEMCR_TRCENA;
+    REG(address_DWT_CTRL) |= DWT_CTRL_CYCCNTENA;
+}
+
+static inline unsigned int cycle_count(void) {
+    return REG(address_DWT_CYCCNT);
+}
+
+static inline unsigned int systick_reload(void) {
+    return REG(address_sysTick_reload);
+}
+
+static inline unsigned int systick_count(void) {
+    return REG(address_sysTick_counter);
+}
+
+/* TRUE if the counter has reloaded but TimerInt has not run yet */
+static inline int systick_pending(void) {
+    return (REG(address_ICSR) & ICSR_PENDSTSET) != 0;
+}
+
+/* TRUE while an exception handler runs; IPSR is readable in any mode */
+static inline int handler_mode(void) {
+    return __get_IPSR() != 0;
+}
+
+/* Cycle counter for unprivileged tasks, read through SVC #4 */
+extern unsigned int     read_cycle_counter( void );
+
+static inline unsigned int task_cycle_count(void) {
+    return read_cycle_counter();
+}
+
+#endif
+
+#endif
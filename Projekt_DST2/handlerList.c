@@ -0,0 +1,50 @@
+#include "handlerList.h"
+#include "compare.h"
+
+#if KERNEL_HANDLERS
+
+handler *PendingHandlers = NULL;
+handler *TimerHandlers = NULL;
+
+/* Behind the handlers with the same deadline, so those run in activation order */
+void handler_insert_pending(handler *pHandler) {
+    handler **ppLink = &PendingHandlers;
+    while (*ppLink != NULL && !time_before(pHandler->Deadline, (*ppLink)->Deadline)) {
+        ppLink = &(*ppLink)->pNextPending;
+    }
+    pHandler->pNextPending = *ppLink;
+    *ppLink = pHandler;
+}
+
+handler *handler_remove_pending(void) {
+    handler *pHandler = PendingHandlers;
+    if (pHandler != NULL) {
+        PendingHandlers = pHandler->pNextPending;
+        pHandler->pNextPending = NULL;
+    }
+    return pHandler;
+}
+
+void handler_insert_timer(handler *pHandler) {
+    handler **ppLink = &TimerHandlers;
+    while (*ppLink != NULL && !time_before(pHandler->nTimer, (*ppLink)->nTimer)) {
+        ppLink = &(*ppLink)->pNextTimer;
+    }
+    pHandler->pNextTimer = *ppLink;
+    *ppLink = pHandler;
+    pHandler->TimerArmed = TRUE;
+}
+
+void handler_unlink_timer(handler *pHandler) {
+    handler **ppLink = &TimerHandlers;
+    while (*ppLink != NULL && *ppLink != pHandler) {
+        ppLink = &(*ppLink)->pNextTimer;
+    }
+    if (*ppLink != NULL) {
+        *ppLink = pHandler->pNextTimer;
+    }
+    pHandler->pNextTimer = NULL;
+    pHandler->TimerArmed = FALSE;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef HANDLERLIST_H
+#define HANDLERLIST_H
+
+#include "kernel_functions.h"
+
+/* The two lists of run-to-completion handlers, see create_handler():
+   - the pending list, of handlers with activations not run yet, earliest
+     Deadline first;
+   - the timer list, of handlers with an armed timer, earliest nTimer first.
+   Called inside kernel calls and the tick only. */
+
+#if KERNEL_HANDLERS
+
+extern handler *PendingHandlers;
+extern handler *TimerHandlers;
+
+void    handler_insert_pending( handler *pHandler );
+handler *handler_remove_pending( void );
+void    handler_insert_timer( handler *pHandler );
+void    handler_unlink_timer( handler *pHandler );
+
+#endif
+
+#endif
@@ -0,0 +1,177 @@
+/* call()/reply_wait() check on the host: a round trip, a client that times
+   out while its request is served and while it is still queued, the reply
+   to a client that has gone, and a server that calls another server.
+   Both mailboxes are server mailboxes: a server gives back a deadline it
+   inherited once the client has timed out, also while it is blocked in a
+   call() of its own, and is not charged the client's miss. A server that
+   terminates fails the call it serves and leaves its mailbox without a
+   receiver. */
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#define DL_CLIENT       (DL_CONTROLLER + 1)
+#define CLIENT_TIMEOUT  5
+#define SLOW_TICKS      20
+
+/* Requests: SLOW takes SLOW_TICKS to serve, CHAIN and up go on to the
+   second server, which takes SLOW_TICKS for CHAIN_SLOW; any other value n
+   is answered with 2n */
+#define SLOW            (-1)
+#define CHAIN           1000
+#define CHAIN_SLOW      (CHAIN + 1)
+
+static mailbox *Requests;
+static mailbox *ChainRequests;
+static mailbox *QuitRequests;
+static uint SlowUntil;
+static int nServed = 0;
+static exception ClientStatus = FAIL;
+static int ClientReply = 0;
+
+/* deadline() and missed_deadlines() of a server at the end of a slow request */
+static uint SlowDeadline, SlowMissed;
+static uint ChainDeadline, ChainMissed;
+static uint ServerMissed;
+
+static void server(void) {
+    int request, reply;
+    set_server_mailbox(Requests);
+    receive_wait(Requests, &request);
+    while (1) {
+        if (request == SLOW) {
+            while ((int) (ticks() - SlowUntil) < 0) {}
+            SlowDeadline = deadline();
+            SlowMissed = missed_deadlines();
+            reply = SLOW;
+        } else if (request >= CHAIN) {
+            if (call(ChainRequests, &request, &reply) != OK) {
+                reply = 0;
+            }
+            ServerMissed = missed_deadlines();
+            reply++;
+        } else {
+            reply = 2 * request;
+        }
+        nServed++;
+        reply_wait(Requests, &reply, &request);
+    }
+}
+
+/* The server behind server() for CHAIN requests */
+static void chain_server(void) {
+    int request, reply;
+    set_server_mailbox(ChainRequests);
+    receive_wait(ChainRequests, &request);
+    while (1) {
+        if (request == CHAIN_SLOW) {
+            while ((int) (ticks() - SlowUntil) < 0) {}
+            ChainDeadline = deadline();
+            ChainMissed = missed_deadlines();
+        }
+        reply = request + 100;
+        reply_wait(ChainRequests, &reply, &request);
+    }
+}
+
+/* Takes one request on QuitRequests and terminates without replying */
+static void quitter(void) {
+    int request;
+    set_server_mailbox(QuitRequests);
+    receive_wait(QuitRequests, &request);
+    terminate();
+}
+
+/* Created after quitter() has gone, likely with its task record */
+static uint BystanderDeadline;
+
+static void bystander(void) {
+    BystanderDeadline = deadline();
+    terminate();
+}
+
+/* Keeps server() busy with a SLOW request, or with a CHAIN_SLOW one that
+   it passes on */
+static int SlowRequest;
+
+static void slow_client(void) {
+    ClientStatus = call(Requests, &SlowRequest, &ClientReply);
+    terminate();
+}
+
+/* call() with a deadline CLIENT_TIMEOUT ticks away */
+static exception call_briefly(mailbox *mBox, int request, int *pReply) {
+    exception status;
+    set_deadline(ticks() + CLIENT_TIMEOUT);
+    status = call(mBox, &request, pReply);
+    set_deadline(DL_CONTROLLER);
+    return status;
+}
+
+void scenario_run(void) {
+    int request, reply;
+    uint nServedBefore;
+    uint nStart;
+
+    Requests = create_mailbox(4, sizeof(int));
+    ChainRequests = create_mailbox(4, sizeof(int));
+    create_task(server, DL_TASKS);
+    create_task(chain_server, DL_TASKS);
+
+    request = 21;
+    check(call(Requests, &request, &reply) == OK && reply == 42, "round trip");
+
+    // times out while the server works on it; the late reply goes nowhere
+    SlowUntil = ticks() + SLOW_TICKS;
+    reply = 0;
+    check(call_briefly(Requests, SLOW, &reply) == DEADLINE_REACHED && reply == 0 &&
+          (int) (ticks() - SlowUntil) < 0, "timeout while served");
+    wait_until(SlowUntil + 2);
+    check(nServed == 2 && reply == 0, "reply to a departed client");
+    check(SlowDeadline == DL_TASKS && SlowMissed == 0, "inheritance ends with the served client");
+    request = 5;
+    check(call(Requests, &request, &reply) == OK && reply == 10, "round trip after a timeout");
+
+    // times out while queued behind slow_client's request
+    SlowUntil = ticks() + SLOW_TICKS;
+    SlowRequest = SLOW;
+    create_task(slow_client, DL_CLIENT);
+    wait(1);
+    nServedBefore = nServed;
+    reply = 0;
+    check(call_briefly(Requests, 7, &reply) == DEADLINE_REACHED && reply == 0, "timeout while queued");
+    wait_until(SlowUntil + 2);
+    check(ClientStatus == OK && ClientReply == SLOW, "round trip of the served client");
+    check(nServed == nServedBefore + 1, "queued request dropped");
+    check(SlowDeadline == DL_CLIENT && SlowMissed == 0, "inheritance ends with the queued client");
+    request = 8;
+    check(call(Requests, &request, &reply) == OK && reply == 16, "round trip after a queued timeout");
+
+    // server() calls chain_server() for it
+    request = CHAIN;
+    check(call(Requests, &request, &reply) == OK && reply == CHAIN + 100 + 1, "server chain");
+
+    // server() is blocked in its call() to chain_server() when the brief
+    // client arrives and when it times out
+    SlowUntil = ticks() + SLOW_TICKS;
+    SlowRequest = CHAIN_SLOW;
+    create_task(slow_client, DL_CLIENT);
+    wait(1);
+    check(call_briefly(Requests, 7, &reply) == DEADLINE_REACHED, "timeout behind a chain");
+    wait_until(SlowUntil + 2);
+    check(ClientStatus == OK && ClientReply == CHAIN_SLOW + 100 + 1, "round trip through a chain");
+    check(ChainDeadline == DL_CLIENT && ChainMissed == 0 && ServerMissed == 0,
+          "inheritance down a chain ends with the client");
+
+    // a server that terminates while serving fails the call
+    QuitRequests = create_mailbox(4, sizeof(int));
+    create_task(quitter, DL_TASKS);
+    request = 1;
+    nStart = ticks();
+    check(call(QuitRequests, &request, &reply) == FAIL && ticks() - nStart < CLIENT_TIMEOUT,
+          "call to a server that terminates");
+
+    // its mailbox has no receiver to inherit a queued client's deadline
+    create_task(bystander, DL_TASKS);
+    check(call_briefly(QuitRequests, 1, &reply) == DEADLINE_REACHED, "call without a server");
+    check(BystanderDeadline == DL_TASKS, "no inheritance by a terminated server");
+}
@@ -0,0 +1,113 @@
+/* Handler check on the host: pending handlers run earliest deadline first,
+   each activation of a handler runs at its own deadline, activations
+   beyond HANDLER_PENDING_MAX fail, and a periodic timer calls back once
+   per period within TIMER_SERVICE_DEADLINE. */
+#include <stdint.h>
+
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#define REL_DEADLINE    20
+#define N_ACTIVATIONS   3
+#define GAP             5           /* ticks between two activations       */
+#define TIMER_PERIOD    5
+#define N_PERIODS       10
+
+#if KERNEL_HANDLERS
+static char Order[4];
+static int nOrder = 0;
+static uint RunDeadline[N_ACTIVATIONS];
+static int nRuns = 0;
+static uint CallAt[N_PERIODS + 1];
+static int nCalls = 0;
+
+static void record(void *pArg) {
+    if (nOrder < (int) sizeof(Order)) {
+        Order[nOrder++] = (char) (intptr_t) pArg;
+    }
+}
+
+/* deadline() in a handler is the dispatcher's, the activation's deadline */
+static void record_deadline(void *pArg) {
+    if (nRuns < N_ACTIVATIONS) {
+        RunDeadline[nRuns] = deadline();
+    }
+    nRuns++;
+}
+
+static void count_call(void *pArg) {
+    if (nCalls <= N_PERIODS) {
+        CallAt[nCalls] = ticks();
+    }
+    nCalls++;
+}
+
+static void spin_until(uint t) {
+    while ((int) (ticks() - t) < 0) {}
+}
+#endif
+
+void scenario_run(void) {
+#if KERNEL_HANDLERS
+    handler *pA = create_handler(record, (void *) 'a', 30);
+    handler *pB = create_handler(record, (void *) 'b', 10);
+    handler *pC = create_handler(record, (void *) 'c', 20);
+    handler *pDeadline = create_handler(record_deadline, NULL, REL_DEADLINE);
+    handler *pTimer = create_timer(count_call, NULL);
+    uint nAt[N_ACTIVATIONS];
+    uint nStart;
+    bool ok;
+    int i;
+
+    // activated together, they run by deadline
+    set_preemption_threshold(PREEMPT_NEVER);
+    activate(pA);
+    activate(pB);
+    activate(pC);
+    set_preemption_threshold(0);
+    wait(40);
+    check(nOrder == 3 && Order[0] == 'b' && Order[1] == 'c' && Order[2] == 'a',
+          "handlers in deadline order");
+
+    // three pending activations, GAP ticks apart, keep their deadlines
+    set_preemption_threshold(PREEMPT_NEVER);
+    nStart = ticks() + 1;
+    for (i = 0; i < N_ACTIVATIONS; i++) {
+        spin_until(nStart + i * GAP);
+        nAt[i] = ticks();
+        activate(pDeadline);
+    }
+    set_preemption_threshold(0);
+    wait(REL_DEADLINE + N_ACTIVATIONS * GAP);
+    ok = (nRuns == N_ACTIVATIONS);
+    for (i = 0; ok && i < N_ACTIVATIONS; i++) {
+        ok = RunDeadline[i] - nAt[i] - REL_DEADLINE <= 1;   // a tick may fall in between
+    }
+    check(ok, "each activation at its own deadline");
+
+    // one more than HANDLER_PENDING_MAX pending activations fails
+    nRuns = 0;
+    set_preemption_threshold(PREEMPT_NEVER);
+    ok = TRUE;
+    for (i = 0; i < HANDLER_PENDING_MAX; i++) {
+        ok = ok && activate(pDeadline) == OK;
+    }
+    check(ok && activate(pDeadline) == FAIL, "activate beyond HANDLER_PENDING_MAX");
+    set_preemption_threshold(0);
+    wait(REL_DEADLINE + 10);
+    check(nRuns == HANDLER_PENDING_MAX, "pending activations run");
+
+    // a periodic timer: call k within TIMER_SERVICE_DEADLINE of expiry k
+    nStart = ticks();
+    start_timer(pTimer, TIMER_PERIOD, TIMER_PERIOD);
+    wait(N_PERIODS * TIMER_PERIOD + TIMER_PERIOD / 2);
+    stop_timer(pTimer);
+    ok = (nCalls == N_PERIODS);
+    for (i = 0; ok && i < N_PERIODS; i++) {
+        ok = CallAt[i] - (nStart + (i + 1) * TIMER_PERIOD) <= TIMER_SERVICE_DEADLINE;
+    }
+    check(ok, "periodic timer");
+    wait(2 * TIMER_PERIOD);
+    check(nCalls == N_PERIODS, "stopped timer");
+#endif
+}
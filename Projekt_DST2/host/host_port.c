@@ -0,0 +1,387 @@
+/* Host (POSIX) port of the kernel.
+   Replaces context_switching_functions_march_2019.s, startup and system code
+   when the kernel is built with gcc on Linux (see Makefile):
+   - every task runs on a ucontext with its own host stack,
+   - isr_off/isr_on mask a virtual SysTick,
+   - SIGALRM preempts the running task and calls TimerInt and, when it
+     asks for it, TimerBottomHalf, and the virtual
+     clock is fast-forwarded whenever only the idle task could run,
+   - built with HOST_VIRTUAL_CLOCK=1, the tasks advance the clock instead
+     through host_run_ticks(), and SIGALRM only ticks while the idle task
+     runs, so a run does not depend on the speed or load of the host,
+   - the Cortex-M private peripheral bus is backed by a scratch mapping so
+     the CMSIS register writes in main.c are harmless.
+*/
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "kernel_functions.h"
+#include "cycleCounter.h"
+#include "kernelTrace.h"
+
+#define HOST_STACK_SIZE   (64 * 1024)   /* host stack of every task          */
+#define HOST_TICK_USEC    20            /* real time between two ticks       */
+#define HOST_IDLE_BATCH   100000        /* ticks skipped at once when idle   */
+#define HOST_PPB_BASE     0xE0000000UL  /* Cortex-M private peripheral bus   */
+#define HOST_PPB_SIZE     0x00100000UL
+#define HOST_SYSTICK_LOAD (*(volatile unsigned int *) 0xE000E014)
+#define HOST_RELOAD       99999         /* SysTick reload if main() sets none */
+
+#ifndef HOST_TICK_LIMIT
+#define HOST_TICK_LIMIT   1000000       /* give up if nothing ends the run   */
+#endif
+
+#ifndef HOST_VIRTUAL_CLOCK
+#define HOST_VIRTUAL_CLOCK 0            /* 1: see host_run_ticks()           */
+#endif
+
+// Host execution context of a task
+typedef struct host_ctx {
+        ucontext_t       uc;
+        void             *pStack;
+        TCB              *pOwner;
+        struct host_ctx  *pNext;
+} host_ctx;
+
+extern TCB *NextTask;
+extern TCB *PreviousTask;
+extern void TimerInt(void);
+extern void TimerBottomHalf(void);
+extern void idle_task(void);
+#if KERNEL_SWITCH_HOOK
+extern void switch_hook(void);
+#else
+#define switch_hook()
+#endif
+
+static host_ctx *Running = NULL;        /* context executing right now       */
+static host_ctx *FreeCtx = NULL;        /* contexts of terminated tasks      */
+static volatile sig_atomic_t Masked = 1;
+static volatile sig_atomic_t TickPending = 0;
+static volatile sig_atomic_t InHandler = 0;    /* emulated handler mode */
+static int BottomHalfPending = 0;               /* emulated PendSV */
+static unsigned int TickStamp = 0;              /* host cycles at the last tick */
+static unsigned int nHostTicks = 0;             /* ticks run, whatever Ticks says */
+static sigset_t TickSignal;
+
+/* Called after every tick. A return value >= 0 ends the run with that exit
+   status; host builds of a test scenario override it. */
+int __attribute__((weak)) host_tick_hook(void) {
+    return -1;
+}
+
+void SystemInit(void) {
+}
+
+unsigned int host_cycle_count(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return (unsigned int) __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned int) (now.tv_sec * 1000000000ull + now.tv_nsec);
+#endif
+}
+
+/* main() programs the mapped SysTick registers through SysTick_Config() */
+unsigned int host_systick_reload(void) {
+    unsigned int reload = HOST_SYSTICK_LOAD;
+    return (reload != 0) ? reload : HOST_RELOAD;
+}
+
+unsigned int host_systick_count(void) {
+    unsigned int reload = host_systick_reload();
+    unsigned int elapsed = host_cycle_count() - TickStamp;
+    return (elapsed < reload) ? reload - elapsed : 0;
+}
+
+int host_handler_mode(void) {
+    return InHandler;
+}
+
+/* The TCB register save area is unused on the host; it holds the task's
+   host context instead. */
+static host_ctx *get_ctx(TCB *tcb) {
+    host_ctx *ctx;
+    memcpy(&ctx, tcb->R4toR11, sizeof(ctx));
+    return (ctx != NULL && ctx->pOwner == tcb) ? ctx : NULL;
+}
+
+static void set_ctx(TCB *tcb, host_ctx *ctx) {
+    ctx->pOwner = tcb;
+    memcpy(tcb->R4toR11, &ctx, sizeof(ctx));
+}
+
+static void retire(host_ctx *ctx) {
+    ctx->pOwner = NULL;
+    ctx->pNext = FreeCtx;
+    FreeCtx = ctx;
+}
+
+static host_ctx *ctx_alloc(void) {
+    host_ctx *ctx = FreeCtx;
+    if (ctx) {
+        FreeCtx = ctx->pNext;
+        return ctx;
+    }
+    ctx = calloc(1, sizeof(host_ctx));
+    if (!ctx || !(ctx->pStack = malloc(HOST_STACK_SIZE))) {
+        fprintf(stderr, "host: out of memory for task context\n");
+        exit(2);
+    }
+    return ctx;
+}
+
+static void task_entry(void) {
+    InHandler = 0;
+    Masked = 0;
+    NextTask->PC();
+    terminate();
+}
+
+/* A task whose SP points into its StackSeg has just had an initial stack
+   frame built by the kernel and is (re)started at its PC on a fresh context.
+   A context that is still executing is retired only after leaving it. */
+static host_ctx *ctx_for(TCB *tcb) {
+    host_ctx *ctx = get_ctx(tcb);
+    if (tcb->SP >= tcb->StackSeg && tcb->SP < tcb->StackSeg + STACK_SIZE) {
+        host_ctx *old = ctx;
+        ctx = ctx_alloc();
+        if (old != NULL) {
+            retire(old);
+        }
+        getcontext(&ctx->uc);
+        ctx->uc.uc_stack.ss_sp = ctx->pStack;
+        ctx->uc.uc_stack.ss_size = HOST_STACK_SIZE;
+        ctx->uc.uc_link = NULL;
+        sigemptyset(&ctx->uc.uc_sigmask);
+        makecontext(&ctx->uc, task_entry, 0);
+        tcb->SP = NULL;
+        set_ctx(tcb, ctx);
+    }
+    return ctx;
+}
+
+/* Suspends the running context and resumes NextTask. */
+static void switch_to_next(void) {
+    host_ctx *from = Running;
+    host_ctx *to = ctx_for(NextTask);
+    if (to == from) {
+        return;
+    }
+    Running = to;
+    swapcontext(&from->uc, &to->uc);
+}
+
+void request_bottom_half(void) {
+    BottomHalfPending = 1;
+}
+
+/* Counterpart of SysTick_Handler and PendSV_Handler. While only the idle task can run the
+   virtual clock is fast-forwarded to the next event. */
+static void systick(void) {
+    int n = 0;
+    int status;
+    // a tick that arrives in the resumed context before it unmasks is
+    // pended, not nested on its stack
+    Masked = 1;
+    InHandler = 1;
+    do {
+        TickStamp = host_cycle_count();
+        TimerInt();
+        if (BottomHalfPending) {
+            BottomHalfPending = 0;
+            TimerBottomHalf();
+            switch_hook();
+        }
+        status = host_tick_hook();
+        if (status >= 0) {
+            exit(status);
+        }
+        if (++nHostTicks >= HOST_TICK_LIMIT) {
+            fprintf(stderr, "host: tick limit %d reached\n", HOST_TICK_LIMIT);
+            exit(3);
+        }
+    } while (NextTask->PC == idle_task && Running->pOwner == NextTask &&
+             ++n < HOST_IDLE_BATCH);
+    switch_to_next();
+    InHandler = 0;
+    Masked = 0;
+}
+
+static void systick_signal(int sig) {
+    (void) sig;
+#if HOST_VIRTUAL_CLOCK
+    if (Running == NULL || Running->pOwner->PC != idle_task) {
+        return;
+    }
+#endif
+    if (Masked) {
+        TickPending = 1;
+        return;
+    }
+    TickPending = 0;
+    systick();
+}
+
+#if HOST_VIRTUAL_CLOCK
+/* The running task executes for nTicks ticks: each is a tick interrupt at
+   this point of the task, which may preempt it. */
+void host_run_ticks(unsigned int nTicks) {
+    while (nTicks-- > 0) {
+        if (Masked) {
+            TickPending = 1;
+        } else {
+            systick();
+        }
+    }
+}
+#endif
+
+__attribute__((constructor))
+static void map_peripherals(void) {
+    void *ppb = mmap((void *) HOST_PPB_BASE, HOST_PPB_SIZE,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (ppb != (void *) HOST_PPB_BASE) {
+        fprintf(stderr, "host: cannot map the peripheral bus\n");
+        exit(2);
+    }
+}
+
+#if KERNEL_TRACE
+/* Writes TraceLog to the file named by $KERNEL_TRACE_DUMP when the run ends,
+   in the raw format read by tools/trace2json. */
+static void dump_trace(void) {
+    const char *path = getenv("KERNEL_TRACE_DUMP");
+    FILE *file;
+    if (path == NULL || (file = fopen(path, "wb")) == NULL) {
+        return;
+    }
+    fwrite(&TraceLog, sizeof(TraceLog), 1, file);
+    fclose(file);
+}
+#endif
+
+void isr_off(void) {
+    Masked = 1;
+}
+
+void isr_on(void) {
+    Masked = 0;
+    if (TickPending) {
+        sigprocmask(SIG_BLOCK, &TickSignal, NULL);
+        if (TickPending) {
+            TickPending = 0;
+            Masked = 1;
+            systick();
+        }
+        sigprocmask(SIG_UNBLOCK, &TickSignal, NULL);
+    }
+}
+
+/* Like SVC #6 and #7, see critical.h */
+uint host_critical_enter(void) {
+    uint state = Masked;
+    Masked = 1;
+    return state;
+}
+
+void host_critical_exit(uint state) {
+    if (state) {
+        Masked = 1;
+    } else {
+        isr_on();
+    }
+}
+
+/* Like SVC #5: runs the kernel call with the tick masked and switches to
+   NextTask if it changed. A task resumed by a switch runs with the tick
+   enabled, as after SVC #2. */
+uintptr_t kernel_call(uint nr, uintptr_t a, uintptr_t b) {
+    int masked = Masked;
+    uintptr_t result;
+    host_ctx *dead;
+
+    Masked = 1;
+    InHandler = 1;
+    result = kernel_dispatch(nr, a, b);
+    if (PreviousTask == NULL) {
+        dead = Running;
+        switch_hook();
+        Running = ctx_for(NextTask);
+        retire(dead);
+        setcontext(&Running->uc);
+    }
+    if (NextTask != PreviousTask) {
+        switch_hook();
+        switch_to_next();
+        masked = 0;
+    }
+    InHandler = 0;
+    if (masked) {
+        Masked = 1;
+    } else {
+        isr_on();
+    }
+    return result;
+}
+
+/* Like SVC #2, leaves the tick enabled in the resumed task. */
+void SwitchContext(void) {
+    InHandler = 1;
+    switch_hook();
+    switch_to_next();
+    InHandler = 0;
+    isr_on();
+}
+
+void LoadContext_In_Run(void) {
+    struct sigaction sa;
+    struct itimerval period;
+
+#if KERNEL_TRACE
+    atexit(dump_trace);
+#endif
+    sigemptyset(&TickSignal);
+    sigaddset(&TickSignal, SIGALRM);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = systick_signal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, NULL);
+
+    period.it_interval.tv_sec = 0;
+    period.it_interval.tv_usec = HOST_TICK_USEC;
+    period.it_value = period.it_interval;
+    setitimer(ITIMER_REAL, &period, NULL);
+
+    TickStamp = host_cycle_count();
+    Running = ctx_for(NextTask);
+    setcontext(&Running->uc);
+}
+
+void switch_to_stack_of_next_task(void) {
+}
+
+/* The TCB of the leaving task is already freed; its context is recycled
+   once the next task runs. */
+void LoadContext_In_Terminate(void) {
+    host_ctx *dead = Running;
+    InHandler = 1;
+    switch_hook();
+    Running = ctx_for(NextTask);
+    retire(dead);
+    setcontext(&Running->uc);
+}
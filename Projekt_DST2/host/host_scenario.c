@@ -0,0 +1,14 @@
+/* Completion check for the main.c unit test on the host: the scenario has
+   passed once every task but task_body_2 and the idle task has terminated
+   and task_body_2 has seen gate g3. */
+#include "kernel_functions.h"
+
+extern unsigned int g0, g3;
+
+int host_tick_hook(void) {
+    if (g3 == OK && ReadyList->pHead && ReadyList->pHead->pNext == ReadyList->pTail &&
+        WaitingList->pHead == NULL && TimerList->pHead == NULL) {
+        return (g0 == OK) ? 0 : 1;
+    }
+    return -1;
+}
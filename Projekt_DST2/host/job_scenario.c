@@ -0,0 +1,59 @@
+/* Job queue check on the host: jobs queued while the worker is busy run in
+   deadline order, and submit_job() fails once JOB_QUEUE_SIZE jobs are
+   queued. */
+#include <stdint.h>
+
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#if JOB_QUEUE_SIZE > 0
+static int Order[JOB_QUEUE_SIZE + 1];
+static int nOrder = 0;
+
+static void record(void *pArg) {
+    if (nOrder < JOB_QUEUE_SIZE + 1) {
+        Order[nOrder] = (int) (intptr_t) pArg;
+    }
+    nOrder++;
+}
+#endif
+
+void scenario_run(void) {
+#if JOB_QUEUE_SIZE > 0
+    int i;
+    bool ordered = TRUE;
+
+    check(start_job_workers(1) == OK, "start_job_workers");
+
+    // under every policy the jobs run only once the controller waits
+    set_preemption_threshold(PREEMPT_NEVER);
+
+    // the idle worker takes job 0 and is busy with it from then on
+    check(submit_job(record, (void *) 0, DL_TASKS + 50) == OK, "submit_job to an idle worker");
+
+    // the rest queue out of order, and the queue fills up
+    check(submit_job(record, (void *) 3, DL_TASKS + 30) == OK &&
+          submit_job(record, (void *) 1, DL_TASKS + 10) == OK &&
+          submit_job(record, (void *) 2, DL_TASKS + 20) == OK, "submit_job to the queue");
+    for (i = 3; i < JOB_QUEUE_SIZE; i++) {
+        submit_job(record, (void *) 4, DL_TASKS + 40);
+    }
+    check(submit_job(record, (void *) 5, DL_TASKS) == FAIL, "submit_job to a full queue");
+
+    set_preemption_threshold(0);
+    wait(100);
+    for (i = 1; i < JOB_QUEUE_SIZE + 1 && i < nOrder; i++) {
+        if (Order[i] < Order[i - 1]) {
+            ordered = FALSE;
+        }
+    }
+    check(nOrder == JOB_QUEUE_SIZE + 1 && Order[0] == 0 && Order[1] == 1 && ordered,
+          "jobs in deadline order");
+
+    // the worker is idle again
+    nOrder = 0;
+    check(submit_job(record, (void *) 0, DL_TASKS) == OK, "submit_job after the queue drained");
+    wait(10);
+    check(nOrder == 1, "job after the queue drained");
+#endif
+}
@@ -0,0 +1,89 @@
+/* Mailbox check on the host: send_no_wait() and receive_no_wait() on
+   mailboxes in which receivers or senders are blocked. The entry of a
+   waiting task is not a message: it is never dropped to make room, and
+   its buffer belongs to the task. A task released by its deadline keeps
+   its entry until it runs again; a message sent or taken in that time
+   neither goes to it nor comes from it. */
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#define DL_PEER         (DL_CONTROLLER - 1)     /* runs as soon as it is ready */
+#define TIMEOUT         5
+
+static mailbox *Box;
+static int Received = 0;
+static exception Status = FAIL;
+
+static void receiver(void) {
+    Status = receive_wait(Box, &Received);
+    terminate();
+}
+
+static void sender(void) {
+    int v = 7;
+    Status = send_wait(Box, &v);
+    terminate();
+}
+
+/* Keeps the CPU until the peer created with deadline nDeadline has been
+   released by it, so the peer's entry is still in Box */
+static void outlast(uint nDeadline) {
+    set_preemption_threshold(PREEMPT_NEVER);
+    while ((int) (ticks() - (nDeadline + 2)) < 0) {}
+}
+
+void scenario_run(void) {
+    int v;
+
+    // a full mailbox holding a waiting receiver hands the message to it
+    Box = create_mailbox(1, sizeof(int));
+    create_task(receiver, DL_PEER);
+    v = 5;
+    check(receive_no_wait(Box, &v) == FAIL && v == 5, "receive_no_wait with a receiver waiting");
+    check(send_no_wait(Box, &v) == OK, "send_no_wait to a waiting receiver");
+    check(Status == OK && Received == 5 && Box->nMessages == 0, "delivery to a waiting receiver");
+
+    // the message of a blocked sender is not dropped for a new one
+    Status = FAIL;
+    create_task(sender, DL_PEER);
+    v = 6;
+    check(send_no_wait(Box, &v) == FAIL, "send_no_wait to a blocked sender's mailbox");
+    check(receive_no_wait(Box, &v) == OK && v == 7 && Status == OK,
+          "receive_no_wait from a blocked sender");
+    check(remove_mailbox(Box) == OK, "empty mailbox");
+
+    // without waiting tasks a full mailbox drops its oldest message
+    Box = create_mailbox(2, sizeof(int));
+    for (v = 1; v <= 3; v++) {
+        send_no_wait(Box, &v);
+    }
+    check(receive_no_wait(Box, &v) == OK && v == 2 &&
+          receive_no_wait(Box, &v) == OK && v == 3 &&
+          receive_no_wait(Box, &v) == FAIL, "overflow drops the oldest message");
+    check(remove_mailbox(Box) == OK, "empty mailbox");
+
+    // a message sent after a receiver timed out stays in the mailbox
+    Box = create_mailbox(2, sizeof(int));
+    Status = OK;
+    Received = 0;
+    create_task(receiver, ticks() + TIMEOUT);
+    outlast(ticks() + TIMEOUT);
+    v = 8;
+    check(send_no_wait(Box, &v) == OK, "send_no_wait after a receiver timed out");
+    set_preemption_threshold(0);
+    wait(1);
+    check(Status == DEADLINE_REACHED && Received == 0, "timed-out receiver gets no message");
+    v = 0;
+    check(receive_no_wait(Box, &v) == OK && v == 8, "message kept for the next receiver");
+
+    // a sender that timed out takes its message back
+    Status = OK;
+    create_task(sender, ticks() + TIMEOUT);
+    outlast(ticks() + TIMEOUT);
+    check(receive_no_wait(Box, &v) == FAIL, "receive_no_wait after a sender timed out");
+    set_preemption_threshold(0);
+    wait(1);
+    check(Status == DEADLINE_REACHED && Box->nMessages == 0, "timed-out sender's message dropped");
+    check(WaitingList->pHead == NULL && TimerList->pHead == NULL &&
+          ReadyList->pHead->pNext == ReadyList->pTail, "task lists intact");
+}
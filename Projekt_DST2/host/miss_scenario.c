@@ -0,0 +1,80 @@
+/* Deadline miss check on the host: a task that runs OVERRUN ticks past its
+   deadline under each miss policy. MISS_CONTINUE keeps the deadline and
+   counts an overrun every tick, MISS_SKIP advances the deadline by its
+   period, MISS_ABORT does so too and restarts the task in its handler,
+   and MISS_DEMOTE gives it DEMOTED_DEADLINE. Each counts one miss. Runs
+   on the virtual clock, so the overruns are counted to the tick. */
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#define MISS_AFTER      5           /* ticks from creation to the deadline */
+#define OVERRUN         3
+#define PERIOD          20
+
+static uint MissAt;                 /* deadline of the task under test */
+static uint SeenDeadline, SeenMissed, SeenOverrun;
+
+static void record(void) {
+    SeenDeadline = deadline();
+    SeenMissed = missed_deadlines();
+    SeenOverrun = overrun_ticks();
+}
+
+/* Runs OVERRUN ticks past MissAt, then records */
+static void overrun(void) {
+    while ((int) (ticks() - (MissAt + OVERRUN)) < 0) {
+        host_run_ticks(1);
+    }
+    record();
+    terminate();
+}
+
+static void continuer(void) {
+    overrun();
+}
+
+static void skipper(void) {
+    set_miss_policy(MISS_SKIP, PERIOD, NULL);
+    overrun();
+}
+
+static void restarted(void) {
+    record();
+    terminate();
+}
+
+static void aborter(void) {
+    set_miss_policy(MISS_ABORT, PERIOD, restarted);
+    while (1) {
+        host_run_ticks(1);
+    }
+}
+
+static void demoter(void) {
+    set_miss_policy(MISS_DEMOTE, 0, NULL);
+    overrun();
+}
+
+/* Runs task, due MISS_AFTER ticks from now, until it has terminated */
+static void run_missing(void (*task)(void)) {
+    SeenDeadline = SeenMissed = SeenOverrun = 0;
+    MissAt = ticks() + MISS_AFTER;
+    create_task(task, MissAt);
+    wait_until(MissAt + PERIOD + 10);
+}
+
+void scenario_run(void) {
+    run_missing(continuer);
+    check(SeenDeadline == MissAt && SeenMissed == 1 && SeenOverrun == OVERRUN + 1,
+          "MISS_CONTINUE");
+
+    run_missing(skipper);
+    check(SeenDeadline == MissAt + PERIOD && SeenMissed == 1 && SeenOverrun == 1, "MISS_SKIP");
+
+    run_missing(aborter);
+    check(SeenDeadline == MissAt + PERIOD && SeenMissed == 1 && SeenOverrun == 1, "MISS_ABORT");
+
+    run_missing(demoter);
+    check(SeenDeadline == DEMOTED_DEADLINE && SeenMissed == 1 && SeenOverrun == 1,
+          "MISS_DEMOTE");
+}
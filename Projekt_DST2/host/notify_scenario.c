@@ -0,0 +1,75 @@
+/* Task notification check on the host: NOTIFY_SET_BITS collects bits
+   while no wait_notification() is pending, NOTIFY_OVERWRITE replaces
+   them, and a notify() to a blocked task hands it the word directly.
+   wait_notification() returns DEADLINE_REACHED when the deadline expires
+   first; a notify() after that is kept for the next wait_notification().
+   Runs on the virtual clock, so a wait(1) lets the other task run first. */
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#define PEER_AHEAD      1000        /* ahead of the controller until it moves */
+#define TIMEOUT         5
+#define ROUNDS          3
+
+static TCB *Waiter, *Late;
+static uint Value[ROUNDS];
+static exception Status[ROUNDS];
+static uint LateValue[2];
+static exception LateStatus[2] = { OK, FAIL };
+static uint LateWoke;
+
+/* Moves behind the controller, so notifications reach it while it is
+   ready, then takes ROUNDS of them */
+static void waiter(void) {
+    int i;
+    Waiter = current_task();
+    set_key(KEY_CONTROLLER + 1);
+    for (i = 0; i < ROUNDS; i++) {
+        Status[i] = wait_notification(&Value[i]);
+    }
+    terminate();
+}
+
+static void late_waiter(void) {
+    Late = current_task();
+    LateStatus[0] = wait_notification(&LateValue[0]);
+    LateWoke = ticks();
+    LateStatus[1] = wait_notification(&LateValue[1]);
+    terminate();
+}
+
+void scenario_run(void) {
+    uint nDeadline;
+
+    set_key(KEY_CONTROLLER);
+    create_task(waiter, ticks() + PEER_AHEAD);
+
+    // bits set while the task is not waiting add up
+    check(notify(Waiter, 0x1, NOTIFY_SET_BITS) == OK &&
+          notify(Waiter, 0x4, NOTIFY_SET_BITS) == OK, "notify a ready task");
+    wait(1);
+    check(Status[0] == OK && Value[0] == 0x5, "NOTIFY_SET_BITS");
+
+    // the waiting task gets the word, the next ones are pending again
+    notify(Waiter, 0x2, NOTIFY_SET_BITS);
+    notify(Waiter, 0x3, NOTIFY_SET_BITS);
+    notify(Waiter, 0x8, NOTIFY_OVERWRITE);
+    wait(1);
+    check(Status[1] == OK && Value[1] == 0x2, "notify a waiting task");
+    check(Status[2] == OK && Value[2] == 0x8, "NOTIFY_OVERWRITE");
+
+    // a notify after the deadline released the task waits for it
+    nDeadline = ticks() + TIMEOUT;
+    create_task(late_waiter, nDeadline);
+    set_preemption_threshold(PREEMPT_NEVER);
+    while ((int) (ticks() - (nDeadline + 2)) < 0) {
+        host_run_ticks(1);
+    }
+    check(notify(Late, 0x10, NOTIFY_SET_BITS) == OK && LateValue[0] == 0,
+          "notify after a timeout");
+    set_preemption_threshold(0);
+    wait(1);
+    check(LateStatus[0] == DEADLINE_REACHED && (int) (LateWoke - nDeadline) >= 0,
+          "wait_notification() timeout");
+    check(LateStatus[1] == OK && LateValue[1] == 0x10, "late notification kept pending");
+}
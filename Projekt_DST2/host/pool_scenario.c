@@ -0,0 +1,113 @@
+/* Task pool check on the host: once warmed up, creating and terminating
+   tasks one after the other reuses the pooled TCBs and their host
+   contexts and allocates nothing. With the heap exhausted, create_task()
+   still takes the pooled tasks and then returns FAIL, freeing what it got.
+   The Makefile links this scenario with malloc(), calloc() and free()
+   wrapped, so the wrappers below count and fail the allocations. */
+#include <stdlib.h>
+
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#define DL_PEER         (DL_CONTROLLER - 1)     /* runs as soon as it is ready */
+#define ROUNDS          (2 * TASK_POOL_SIZE + 2)
+#define SLEEP           10
+
+static int nAllocs = 0, nFrees = 0;
+static int AllocsLeft = -1;         /* allocations that still succeed, -1 all */
+static int nRuns = 0, nSlept = 0;
+static uint Release;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void __real_free(void *p);
+
+void *__wrap_malloc(size_t size) {
+    nAllocs++;
+    if (AllocsLeft == 0) {
+        return NULL;
+    }
+    if (AllocsLeft > 0) {
+        AllocsLeft--;
+    }
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    nAllocs++;
+    if (AllocsLeft == 0) {
+        return NULL;
+    }
+    if (AllocsLeft > 0) {
+        AllocsLeft--;
+    }
+    return __real_calloc(n, size);
+}
+
+void __wrap_free(void *p) {
+    if (p != NULL) {
+        nFrees++;
+    }
+    __real_free(p);
+}
+
+static void quick(void) {
+    nRuns++;
+    terminate();
+}
+
+static void sleeper(void) {
+    wait_until(Release);
+    nSlept++;
+    terminate();
+}
+
+static int ready_count(void) {
+    int n = 0;
+    listobj *node;
+    for (node = ReadyList->pHead; node != NULL; node = node->pNext) {
+        n++;
+    }
+    return n;
+}
+
+void scenario_run(void) {
+    int i, nReady;
+    bool ok = TRUE;
+
+    // warm up the pool and the host contexts
+    create_task(quick, DL_PEER);
+    nAllocs = 0;
+    for (i = 0; i < ROUNDS; i++) {
+        ok = ok && create_task(quick, DL_PEER) == OK;
+    }
+    check(ok && nRuns == ROUNDS + 1, "create_task and terminate in turn");
+#if TASK_POOL_SIZE > 0
+    check(nAllocs == 0, "terminated tasks reused");
+#endif
+
+    // fill the pool
+    Release = ticks() + SLEEP;
+    for (i = 0; i < TASK_POOL_SIZE; i++) {
+        create_task(sleeper, DL_TASKS);
+    }
+    wait_until(Release + 1);
+
+    // with the heap exhausted only the pooled tasks can be created
+    nReady = ready_count();
+    Release = ticks() + SLEEP;
+    AllocsLeft = 0;
+    for (i = 0; i < TASK_POOL_SIZE; i++) {
+        ok = ok && create_task(sleeper, DL_TASKS) == OK;
+    }
+    check(ok, "create_task from the pool");
+    check(create_task(sleeper, DL_TASKS) == FAIL, "create_task with the pool exhausted");
+    nAllocs = nFrees = 0;
+    AllocsLeft = 1;
+    check(create_task(sleeper, DL_TASKS) == FAIL && nAllocs == 2 && nFrees == 1,
+          "create_task frees its node when the TCB fails");
+    AllocsLeft = -1;
+    check(ready_count() == nReady + TASK_POOL_SIZE, "ReadyList intact");
+    wait_until(Release + 1);
+    check(nSlept == 2 * TASK_POOL_SIZE && ready_count() == nReady, "pooled tasks run");
+}
@@ -0,0 +1,54 @@
+/* See scenario.h */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+
+#include "scenario.h"
+
+#define KEY_BASE        10000       /* ticks from the start to key 0 */
+
+static int nFailed = 0;
+static int Done = FALSE;
+static uint KeyBase;
+
+void check(bool ok, const char *name) {
+    if (!ok) {
+        fprintf(stderr, "%s: %s failed\n", program_invocation_short_name, name);
+        nFailed++;
+    }
+}
+
+void wait_until(uint t) {
+    if ((int) (t - ticks()) > 0) {
+        wait(t - ticks());
+    }
+}
+
+void set_key(uint nKey) {
+    set_task_params(nKey, nKey, 0);
+    set_deadline(KeyBase + nKey);
+}
+
+int host_tick_hook(void) {
+    if (!Done) {
+        return -1;
+    }
+    return (nFailed == 0) ? 0 : 1;
+}
+
+static void controller(void) {
+    KeyBase = ticks() + KEY_BASE;
+    scenario_run();
+    Done = TRUE;
+    while (1) {
+        wait(100000);
+    }
+}
+
+int main(void) {
+    if (init_kernel() != OK || create_task(controller, DL_CONTROLLER) != OK) {
+        return 1;
+    }
+    run();
+    return 0;
+}
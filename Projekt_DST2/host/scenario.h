@@ -0,0 +1,34 @@
+/* Scaffolding shared by the host scenarios. A scenario defines
+   scenario_run() with its checks and the tasks it creates; scenario.c has
+   main() and the controller task, which runs scenario_run() at deadline
+   DL_CONTROLLER. Once it returns the host port ends the run with exit
+   status 0 if every check passed and 1 otherwise. A failed check is named
+   on stderr. */
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include "kernel_functions.h"
+
+#define DL_CONTROLLER   100000
+#define DL_TASKS        200000      /* behind the controller */
+
+/* Key of the controller once it calls set_key(KEY_CONTROLLER) */
+#define KEY_CONTROLLER  50000
+
+void            scenario_run( void );
+
+void            check( bool ok, const char *name );
+
+/* Sleeps until tick t, which may lie past a wrap of Ticks */
+void            wait_until( uint t );
+
+/* Gives the calling task scheduling key nKey under every policy: a task
+   with a smaller key runs first. EDF and LLF keys are deadlines, counted
+   from a base well after the scenario ends. */
+void            set_key( uint nKey );
+
+/* On the virtual clock, see the Makefile: the running task executes for
+   nTicks ticks */
+void            host_run_ticks( unsigned int nTicks );
+
+#endif
@@ -0,0 +1,72 @@
+/* Timer slack check on the host: a wait() of t ticks with s ticks of
+   slack ends within [t, t + s], together with another task's wakeup that
+   falls in that window, and at the end of the window when none does.
+   wait_until_hires() ignores the slack and ends in the tick of its time. */
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#define WAIT_TICKS      10
+#define SLACK_TICKS     10
+#define OTHER_TICKS     14          /* the other wakeup, within the slack */
+#define ALONE           50          /* start of the wait without company  */
+#define HIRES           100         /* start of the wait_until_hires()    */
+
+static uint Start;
+static uint SlackWoke, OtherWoke, AloneWoke, HiresWoke;
+static exception HiresStatus = FAIL;
+static bool HiresReached = FALSE;
+
+/* Sleeps with the task's default slack */
+static void slack_task(void) {
+    wait_until(Start);
+    set_timer_slack(SLACK_TICKS);
+    wait(WAIT_TICKS);
+    SlackWoke = ticks();
+    terminate();
+}
+
+static void other_task(void) {
+    wait_until(Start);
+    wait(OTHER_TICKS);
+    OtherWoke = ticks();
+    terminate();
+}
+
+/* Sleeps with explicit slack while no other task wakes up */
+static void alone_task(void) {
+    wait_until(Start + ALONE);
+    wait_slack(WAIT_TICKS, SLACK_TICKS);
+    AloneWoke = ticks();
+    terminate();
+}
+
+/* Sleeps until half a tick into tick Start + HIRES + WAIT_TICKS */
+static void hires_task(void) {
+    hires t;
+    wait_until(Start + HIRES);
+    set_timer_slack(SLACK_TICKS);
+    t = ticks_to_hires(Start + HIRES + WAIT_TICKS) + ticks_to_hires(1) / 2;
+    HiresStatus = wait_until_hires(t);
+    HiresReached = hires_time() >= t;
+    HiresWoke = ticks();
+    terminate();
+}
+
+void scenario_run(void) {
+    uint t;
+
+    Start = ticks() + 10;
+    check(create_task(slack_task, DL_TASKS) == OK &&
+          create_task(other_task, DL_TASKS) == OK &&
+          create_task(alone_task, DL_TASKS) == OK &&
+          create_task(hires_task, DL_TASKS) == OK, "create_task");
+
+    wait_until(Start + HIRES + WAIT_TICKS + SLACK_TICKS + 10);
+    check(OtherWoke == Start + OTHER_TICKS, "wait() without slack");
+    check(SlackWoke == OtherWoke, "wakeups coalesce within the slack");
+    t = AloneWoke - (Start + ALONE);
+    check(t >= WAIT_TICKS && t <= WAIT_TICKS + SLACK_TICKS, "wakeup within the slack");
+    check(t == WAIT_TICKS + SLACK_TICKS, "wakeup deferred to the end of the slack");
+    check(HiresStatus == OK && HiresReached && HiresWoke == Start + HIRES + WAIT_TICKS,
+          "wait_until_hires() without slack");
+}
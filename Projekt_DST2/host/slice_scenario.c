@@ -0,0 +1,74 @@
+/* Time slice check on the host: two ready tasks with the same key take
+   turns, each running TIME_SLICE_TICKS ticks before the other. Time
+   slicing is off by default, so the Makefile builds this scenario with a
+   kernel of its own, on the virtual clock of host_port.c. With
+   TIME_SLICE_TICKS set to 0 in KERNEL_DEFINES there is nothing to check. */
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#if TIME_SLICE_TICKS > 0
+/* Keys, see set_key() */
+#define KEY_TASKS       1000
+
+#define RUN_TICKS       (10 * TIME_SLICE_TICKS)
+#define MAX_TURNS       16
+
+static uint Start;                  /* tick both tasks wake at        */
+static volatile int Current = -1;   /* task that ran last             */
+
+/* Who ran from which tick on */
+static int TurnTask[MAX_TURNS];
+static uint TurnTick[MAX_TURNS];
+static int nTurns = 0;
+
+static void take_turns(int me) {
+    set_key(KEY_TASKS);
+    wait_until(Start);
+    while ((int) (ticks() - (Start + RUN_TICKS)) < 0) {
+        if (Current != me) {
+            Current = me;
+            if (nTurns < MAX_TURNS) {
+                TurnTask[nTurns] = me;
+                TurnTick[nTurns] = ticks();
+            }
+            nTurns++;
+        }
+        host_run_ticks(1);
+    }
+    terminate();
+}
+
+static void task_a(void) {
+    take_turns(0);
+}
+
+static void task_b(void) {
+    take_turns(1);
+}
+#endif
+
+void scenario_run(void) {
+#if TIME_SLICE_TICKS > 0
+    int i;
+    bool alternate = TRUE;
+    bool sliced = TRUE;
+
+    Start = ticks() + 10;
+    set_key(KEY_CONTROLLER);
+    check(create_task(task_a, DL_TASKS) == OK &&
+          create_task(task_b, DL_TASKS) == OK, "create_task");
+
+    wait_until(Start + RUN_TICKS + 10);
+    for (i = 1; i < nTurns && i < MAX_TURNS; i++) {
+        if (TurnTask[i] == TurnTask[i - 1]) {
+            alternate = FALSE;
+        }
+        if (TurnTick[i] - TurnTick[i - 1] != TIME_SLICE_TICKS) {
+            sliced = FALSE;
+        }
+    }
+    check(nTurns >= RUN_TICKS / TIME_SLICE_TICKS, "every slice a turn");
+    check(alternate, "equal keys alternate");
+    check(sliced, "turns of TIME_SLICE_TICKS");
+#endif
+}
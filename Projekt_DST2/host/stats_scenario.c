@@ -0,0 +1,179 @@
+/* Statistics check on the host: the stack high-water mark of a task grows
+   with its stack use, and a stack recycled from the task pool is painted
+   again before the next task starts on it. On the host port tasks run on
+   host stacks, see stackCheck.h, so the scenario writes the words a deep
+   call chain would use on the target itself. A task that keeps the CPU
+   busy gets a larger share of it in cpu_usage_snapshot() than one that
+   sleeps. The max masked time of a call site is at least its longest
+   stretch, here a short one followed by a long one, and lies in the
+   highest bin of its histogram; the Makefile builds this scenario with
+   KERNEL_MASK_STATS set. */
+#include <string.h>
+
+#include "kernel_functions.h"
+#include "scenario.h"
+#include "stackCheck.h"
+#include "cpuUsage.h"
+#include "maskStats.h"
+#include "critical.h"
+#include "cycleCounter.h"
+
+#define DL_PEER         (DL_CONTROLLER - 1)     /* runs as soon as it is ready */
+
+#if KERNEL_STACK_CHECK
+#define DEPTH           (STACK_SIZE / 2)        /* words the deep task uses */
+
+static uint FreshPeak, DeepPeak, ReusedPeak;
+static bool DeepOverflow = TRUE;
+
+/* Uses nWords below the initial frame, as far down as a call chain of
+   that depth would on the target */
+static void use_stack(int nWords) {
+    TCB *me = current_task();
+    int i;
+    for (i = 1; i <= nWords; i++) {
+        me->StackSeg[STACK_SIZE - 9 - i] = i;
+    }
+}
+
+static void deep(void) {
+    FreshPeak = stack_peak();
+    use_stack(DEPTH);
+    DeepPeak = stack_peak();
+    DeepOverflow = stack_overflowed();
+    terminate();
+}
+
+static void reused(void) {
+    ReusedPeak = stack_peak();
+    terminate();
+}
+
+static void check_stack(void) {
+    create_task(deep, DL_PEER);
+    check(DeepPeak >= FreshPeak + DEPTH && !DeepOverflow, "stack_peak() after deep use");
+    create_task(reused, DL_PEER);
+    check(ReusedPeak == FreshPeak, "recycled stack painted again");
+}
+#endif
+
+#if KERNEL_CPU_STATS
+#define BUSY            50          /* ticks the busy task spins */
+#define MAX_TASKS       8
+
+static TCB *Busy, *Lazy;
+
+static void busy(void) {
+    uint t = ticks() + BUSY;
+    Busy = current_task();
+    while ((int) (ticks() - t) < 0) {}
+    wait(10 * BUSY);
+    terminate();
+}
+
+static void lazy(void) {
+    Lazy = current_task();
+    wait(10 * BUSY);
+    terminate();
+}
+
+/* The entry of pTask, NULL if the snapshot has none */
+static cpu_usage *usage_of(cpu_usage *pUsage, int n, TCB *pTask) {
+    int i;
+    for (i = 0; i < n; i++) {
+        if (pUsage[i].pTask == pTask) {
+            return &pUsage[i];
+        }
+    }
+    return NULL;
+}
+
+static void check_cpu_usage(void) {
+    cpu_usage aUsage[MAX_TASKS];
+    cpu_usage *pBusy, *pLazy;
+    int n;
+
+    create_task(lazy, DL_PEER);
+    create_task(busy, DL_PEER);
+    n = cpu_usage_snapshot(aUsage, MAX_TASKS);
+    pBusy = usage_of(aUsage, n, Busy);
+    pLazy = usage_of(aUsage, n, Lazy);
+    check(pBusy != NULL && pLazy != NULL, "cpu_usage_snapshot()");
+    check(pBusy != NULL && pLazy != NULL && pBusy->nCycles > pLazy->nCycles &&
+          pBusy->nPermille > pLazy->nPermille, "busy task's CPU share above a sleeping one's");
+}
+#endif
+
+#if KERNEL_MASK_STATS
+#define SHORT_MASK      100         /* cycles */
+#define LONG_MASK       100000
+
+/* The only critical section of this file, so its site is __FILE__ */
+static void masked(uint nCycles) {
+    uint state = critical_enter();
+    uint t = cycle_count();
+    while (cycle_count() - t < nCycles) {}
+    critical_exit(state);
+}
+
+/* TRUE if the counts and the max of pStats agree with its histogram: the
+   max falls in the highest bin used */
+static bool consistent(const mask_stats *pStats) {
+    uint nSum = 0;
+    int k, nTop = -1;
+    for (k = 0; k < MASK_HIST_BINS; k++) {
+        nSum += pStats->aHistogram[k];
+        if (pStats->aHistogram[k] != 0) {
+            nTop = k;
+        }
+    }
+    if (nSum != pStats->nCount) {
+        return FALSE;
+    }
+    if (nTop <= 0) {
+        return nTop == 0 || pStats->nMax == 0;
+    }
+    return pStats->nMax >= (1u << nTop) &&
+           (nTop == MASK_HIST_BINS - 1 || pStats->nMax < (2u << nTop));
+}
+
+static void check_mask_stats(void) {
+    mask_stats aStats[MASK_STATS_SITES];
+    mask_stats latency;
+    mask_stats *pMine = NULL;
+    bool ok = TRUE, calls = FALSE;
+    int i, n;
+
+    wait(10);
+    masked(SHORT_MASK);
+    masked(LONG_MASK);
+    n = mask_stats_snapshot(aStats, MASK_STATS_SITES);
+    for (i = 0; i < n; i++) {
+        ok = ok && consistent(&aStats[i]);
+        if (strcmp(aStats[i].pFile, "kernel_call") == 0 && aStats[i].nCount > 0) {
+            calls = TRUE;
+        }
+        if (strcmp(aStats[i].pFile, __FILE__) == 0) {
+            pMine = &aStats[i];
+        }
+    }
+    check(calls, "kernel calls timed");
+    check(ok, "masked time per site");
+    check(pMine != NULL && pMine->nCount == 2 && pMine->nMax >= LONG_MASK,
+          "max masked time at least the last stretch");
+    tick_latency_stats(&latency);
+    check(latency.nCount > 0 && consistent(&latency), "tick latency");
+}
+#endif
+
+void scenario_run(void) {
+#if KERNEL_STACK_CHECK
+    check_stack();
+#endif
+#if KERNEL_CPU_STATS
+    check_cpu_usage();
+#endif
+#if KERNEL_MASK_STATS
+    check_mask_stats();
+#endif
+}
@@ -0,0 +1,62 @@
+/* Preemption threshold check on the host: a running task with a threshold
+   is not preempted by a task whose key lies between its own key and its
+   threshold, is preempted by a task beyond it, and then still runs before
+   the task it held back. The keys are set the same way under every policy. */
+#include "kernel_functions.h"
+#include "scenario.h"
+
+/* Keys, see set_key() */
+#define KEY_LOW         1000
+#define THRESHOLD_LOW   500
+#define KEY_MID         700         /* within the threshold of low */
+#define KEY_HIGH        200         /* beyond it                   */
+
+static uint Start;                  /* tick low starts running at     */
+static char Log[4];
+static int nLog = 0;
+
+static void record(char c) {
+    if (nLog < (int) sizeof(Log) - 1) {
+        Log[nLog] = c;
+    }
+    nLog++;
+}
+
+static void low(void) {
+    set_key(KEY_LOW);
+    set_preemption_threshold(THRESHOLD_LOW);
+    wait_until(Start);
+    while ((int) (ticks() - (Start + 6)) < 0) {}
+    record('l');
+    terminate();
+}
+
+static void mid(void) {
+    set_key(KEY_MID);
+    wait_until(Start + 2);
+    record('m');
+    terminate();
+}
+
+static void high(void) {
+    set_key(KEY_HIGH);
+    wait_until(Start + 4);
+    record('h');
+    terminate();
+}
+
+void scenario_run(void) {
+    uint nAvoided;
+
+    Start = ticks() + 10;
+    set_key(KEY_CONTROLLER);
+    check(create_task(low, DL_TASKS) == OK &&
+          create_task(mid, DL_TASKS) == OK &&
+          create_task(high, DL_TASKS) == OK, "create_task");
+    nAvoided = avoided_preemptions();
+
+    wait_until(Start + 20);
+    check(nLog == 3 && Log[0] == 'h' && Log[1] == 'l' && Log[2] == 'm',
+          "preemption within and beyond the threshold");
+    check(avoided_preemptions() == nAvoided + 1, "avoided_preemptions");
+}
@@ -0,0 +1,122 @@
+/* Tick wraparound check on the host: starts Ticks 256 ticks before the
+   wrap and runs a periodic task, EDF ordering, deadline misses, software
+   timers (with KERNEL_HANDLERS) and hires_time() across it. */
+#include "kernel_functions.h"
+#include "scenario.h"
+
+#define WRAP_START      (0u - 256)
+#define PERIOD          10
+#define N_JOBS          60
+#define TIMER_PERIOD    7
+#define CHECK_AT        400         /* after the wrap, once all is done */
+
+static uint nLateJobs = 0;
+static uint nJobs = 0;
+static char Order[3];
+static int nOrder = 0;
+static bool MissOk = FALSE;
+#if KERNEL_HANDLERS
+static uint nTimerCalls = 0;
+static uint OneShotAt = 0;
+#endif
+
+/* Wakes at every release, not before it and within its period */
+static void periodic(void) {
+    uint release = ticks();
+    while (nJobs < N_JOBS) {
+        release += PERIOD;
+        set_deadline(release + PERIOD);
+        if (wait(release - ticks()) != OK || (int) (ticks() - release) < 0) {
+            nLateJobs++;
+        }
+        nJobs++;
+    }
+    terminate();
+}
+
+static void early(void) {
+    Order[nOrder++] = 'e';
+    terminate();
+}
+
+static void late(void) {
+    Order[nOrder++] = 'l';
+    terminate();
+}
+
+/* Its deadline, 1, lies past the wrap: no miss before it, one after */
+static void misser(void) {
+    uint nDeadline = deadline();
+    bool before = TRUE;
+    // a miss counts as early only if the deadline is still ahead after it
+    while ((int) (ticks() - nDeadline) < 0) {
+        if (missed_deadlines() != 0 && (int) (ticks() - nDeadline) < 0) {
+            before = FALSE;
+        }
+    }
+    while ((int) (ticks() - (nDeadline + 1)) < 0) {}
+    MissOk = before && missed_deadlines() == 1;
+    terminate();
+}
+
+#if KERNEL_HANDLERS
+static void count_call(void *pArg) {
+    nTimerCalls++;
+}
+
+static void one_shot(void *pArg) {
+    OneShotAt = ticks();
+}
+#endif
+
+void scenario_run(void) {
+#if KERNEL_HANDLERS
+    handler *pPeriodic, *pOneShot;
+    uint nTimerStart, nOneShotStart;
+#endif
+    uint nHiresStart;
+    hires before, after;
+
+    set_ticks(WRAP_START);
+    set_deadline(ticks() + 100000);
+    create_task(periodic, ticks() + PERIOD);
+#if KERNEL_HANDLERS
+    pPeriodic = create_timer(count_call, NULL);
+    pOneShot = create_timer(one_shot, NULL);
+    nTimerStart = ticks();
+    start_timer(pPeriodic, TIMER_PERIOD, TIMER_PERIOD);
+#endif
+    before = hires_time();
+    nHiresStart = ticks();
+
+    // early's deadline is before the wrap, late's after it
+    wait_until(0u - 10);
+    set_preemption_threshold(PREEMPT_NEVER);
+    create_task(late, ticks() + 20);
+    create_task(early, ticks() + 3);
+#if KERNEL_HANDLERS
+    nOneShotStart = ticks();
+    start_timer(pOneShot, 30, 0);
+#endif
+    set_preemption_threshold(0);
+
+    // not 0u - 2 or 0u - 1, which are no times, see compare.h
+    wait_until(0u - 4);
+    create_task(misser, ticks() + 5);
+
+    wait_until(CHECK_AT);
+    after = hires_time();
+
+    check(nJobs == N_JOBS && nLateJobs == 0, "periodic task");
+    check(nOrder == 2 && Order[0] == 'e' && Order[1] == 'l', "EDF order");
+    check(MissOk, "deadline miss");
+#if KERNEL_HANDLERS
+    stop_timer(pPeriodic);
+    check(nTimerCalls + 1 >= (CHECK_AT - nTimerStart) / TIMER_PERIOD &&
+          nTimerCalls <= (CHECK_AT - nTimerStart) / TIMER_PERIOD, "periodic timer");
+    check(OneShotAt - nOneShotStart >= 30 &&
+          OneShotAt - nOneShotStart <= 30 + TIMER_SERVICE_DEADLINE, "one-shot timer");
+#endif
+    check(after > before &&
+          after - before >= ticks_to_hires(CHECK_AT - nHiresStart - 1), "hires_time");
+}
@@ -0,0 +1,47 @@
+#include "jobQueue.h"
+#include "compare.h"
+
+#if JOB_QUEUE_SIZE > 0
+
+static job JobPool[JOB_QUEUE_SIZE];
+static job *pFreeJobs = NULL;
+static int nPoolUsed = 0;               /* JobPool entries handed out once  */
+static job *pJobHead = NULL;            /* pending jobs, earliest deadline first */
+
+/* Returns a free job record, NULL when all JOB_QUEUE_SIZE are queued */
+job *job_alloc(void) {
+    job *pJob = pFreeJobs;
+    if (pJob != NULL) {
+        pFreeJobs = pJob->pNext;
+        return pJob;
+    }
+    if (nPoolUsed < JOB_QUEUE_SIZE) {
+        return &JobPool[nPoolUsed++];
+    }
+    return NULL;
+}
+
+void job_free(job *pJob) {
+    pJob->pNext = pFreeJobs;
+    pFreeJobs = pJob;
+}
+
+/* Behind the jobs with the same deadline, so those run in submission order */
+void job_insert_sort(job *pJob) {
+    job **ppLink = &pJobHead;
+    while (*ppLink != NULL && !time_before(pJob->Deadline, (*ppLink)->Deadline)) {
+        ppLink = &(*ppLink)->pNext;
+    }
+    pJob->pNext = *ppLink;
+    *ppLink = pJob;
+}
+
+job *job_remove_head(void) {
+    job *pJob = pJobHead;
+    if (pJob != NULL) {
+        pJobHead = pJob->pNext;
+    }
+    return pJob;
+}
+
+#endif
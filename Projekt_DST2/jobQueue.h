@@ -0,0 +1,20 @@
+#ifndef JOBQUEUE_H
+#define JOBQUEUE_H
+
+#include "kernel_functions.h"
+
+/* Deadline-ordered queue of the jobs waiting for a job worker, see
+   submit_job(). The records come from a fixed pool of JOB_QUEUE_SIZE
+   entries, so queueing a job never touches the heap. Called inside kernel
+   calls only. */
+
+#if JOB_QUEUE_SIZE > 0
+
+job *   job_alloc( void );
+void    job_free( job *pJob );
+void    job_insert_sort( job *pJob );
+job *   job_remove_head( void );
+
+#endif
+
+#endif
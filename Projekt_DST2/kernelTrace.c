@@ -0,0 +1,27 @@
+#include "kernelTrace.h"
+
+#if KERNEL_TRACE
+
+extern TCB *NextTask;
+
+trace_log TraceLog = { TRACE_MAGIC, TRACE_BUFFER_SIZE, 0, 0 };
+
+static TCB *TracedTask = NULL;          /* task of the last TRACE_SWITCH */
+
+/* Called by run(), still in privileged mode. */
+void trace_start(void) {
+    TraceLog.nReload = systick_reload();
+    TRACE(TRACE_SWITCH, NextTask, NULL);
+    TracedTask = NextTask;
+}
+
+/* Called by switch_hook() in handler mode; records a switch only when the
+   running task really changes. */
+void trace_switch(void) {
+    if (NextTask != TracedTask) {
+        TRACE(TRACE_SWITCH, NextTask, TracedTask);
+        TracedTask = NextTask;
+    }
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef KERNELTRACE_H
+#define KERNELTRACE_H
+
+#include "kernel_functions.h"
+#include "traceFormat.h"
+
+/* Binary trace of scheduler events.
+   Events go into the ring buffer TraceLog, overwriting the oldest ones, and
+   are timestamped with Ticks plus the SysTick counter when recorded in
+   handler mode. Read the buffer with dumpTrace() in trace_dump.mac and
+   convert it with tools/trace2json. With KERNEL_TRACE set to 0 the TRACE
+   calls compile to nothing. */
+
+#if KERNEL_TRACE
+
+#include "cycleCounter.h"
+
+// Trace log, see traceFormat.h
+typedef struct {
+        uint            nMagic;
+        uint            nSize;          /* entries in aEntry            */
+        uint            nReload;        /* SysTick reload value         */
+        uint            nIndex;         /* events recorded so far       */
+        trace_entry     aEntry[TRACE_BUFFER_SIZE];
+} trace_log;
+
+extern trace_log TraceLog;
+
+void    trace_start( void );
+void    trace_switch( void );
+
+/* Callers hold the tick off, or run in handler mode */
+static inline void trace_event(uint event, TCB *pTask, uint nArg) {
+    trace_entry *pEntry = &TraceLog.aEntry[TraceLog.nIndex++ & (TRACE_BUFFER_SIZE - 1)];
+    pEntry->nTicks = Ticks;
+    pEntry->nCount = (event << 24) | (handler_mode() ? systick_count() : TRACE_NO_COUNT);
+    pEntry->pTask = (uint) pTask;
+    pEntry->nArg = nArg;
+}
+
+#define TRACE(event, pTask, nArg)       trace_event(event, pTask, (uint) (nArg))
+
+#else
+
+#define TRACE(event, pTask, nArg)
+#define trace_start()
+#define trace_switch()
+
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef KERNEL_CONFIG_H
+#define KERNEL_CONFIG_H
+
+/*********************************************************/
+/** Compile-time kernel options                          */
+/** Only preprocessor definitions: this file is also     */
+/** included by the context switching assembly.         */
+/*********************************************************/
+
+/* Per-task CPU time accounting with the DWT cycle counter, see cpuUsage.h */
+#ifndef KERNEL_CPU_STATS
+#define KERNEL_CPU_STATS        1
+#endif
+
+/* Stack painting and high-water marks, see stackCheck.h */
+#ifndef KERNEL_STACK_CHECK
+#define KERNEL_STACK_CHECK      1
+#endif
+
+/* Masked time per call site and tick latency, see maskStats.h; for
+   measurement builds only */
+#ifndef KERNEL_MASK_STATS
+#define KERNEL_MASK_STATS       0
+#endif
+
+#ifndef MASK_STATS_SITES
+#define MASK_STATS_SITES        16      /* call sites with their own entry */
+#endif
+
+#ifndef MASK_HIST_BINS
+#define MASK_HIST_BINS          16      /* log2 histogram bins             */
+#endif
+
+/* Scheduling policy of the ReadyList, see schedPolicy.h */
+#define POLICY_EDF              0       /* earliest deadline first         */
+#define POLICY_RM               1       /* rate monotonic                  */
+#define POLICY_DM               2       /* deadline monotonic              */
+#define POLICY_LLF              3       /* least laxity first              */
+
+#ifndef KERNEL_POLICY
+#define KERNEL_POLICY           POLICY_EDF
+#endif
+
+/* Round-robin time slice, in ticks, among ready tasks with the same
+   scheduling key; 0 lets the running one keep the CPU until it blocks */
+#ifndef TIME_SLICE_TICKS
+#define TIME_SLICE_TICKS        0
+#endif
+
+/* Terminated TCBs kept for reuse by create_task, 0 frees them all */
+#ifndef TASK_POOL_SIZE
+#define TASK_POOL_SIZE          4
+#endif
+
+/* Jobs that can wait for a job worker, see submit_job(); 0 leaves the
+   job queue out */
+#ifndef JOB_QUEUE_SIZE
+#define JOB_QUEUE_SIZE          8
+#endif
+
+/* Run-to-completion handlers on one shared stack, see create_handler() */
+#ifndef KERNEL_HANDLERS
+#define KERNEL_HANDLERS         1
+#endif
+
+/* Pending activations per handler, each with its own deadline; one more
+   is refused, see activate() */
+#ifndef HANDLER_PENDING_MAX
+#define HANDLER_PENDING_MAX     8
+#endif
+
+/* Relative deadline of the software timer callbacks, see create_timer() */
+#ifndef TIMER_SERVICE_DEADLINE
+#define TIMER_SERVICE_DEADLINE  10
+#endif
+
+/* Binary ring buffer of scheduler events, see kernelTrace.h */
+#ifndef KERNEL_TRACE
+#define KERNEL_TRACE            0
+#endif
+
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE       256     /* events, must be a power of two */
+#endif
+
+/* The context switch code calls switch_hook() if any option needs it */
+#define KERNEL_SWITCH_HOOK      (KERNEL_CPU_STATS || KERNEL_TRACE)
+
+#endif
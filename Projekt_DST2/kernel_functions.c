@@ -2,11 +2,20 @@
 #include "linkedList.h"
 #include "mailboxList.h"
 #include "compare.h"
+#include "schedPolicy.h"
+#include "cpuUsage.h"
+#include "kernelTrace.h"
+#include "stackCheck.h"
+#include "cycleCounter.h"
+#include "critical.h"
+#include "jobQueue.h"
+#include "handlerList.h"
 #include<limits.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 /* Global variable definitions */
-int Ticks = 0;                   /* global sysTick counter */
+uint Ticks = 0;                   /* global sysTick counter */
 int KernelMode = INIT;           /* Kernel mode: INIT or RUNNING */
 TCB *PreviousTask = NULL;
 TCB *NextTask = NULL;        
@@ -16,12 +25,102 @@ list *ReadyList = NULL;
 list *WaitingList = NULL;
 list *TimerList = NULL;
 
+/* System call numbers, the index into SyscallTable */
+enum {
+    SYS_CREATE_TASK,
+    SYS_TERMINATE,
+    SYS_SEND_WAIT,
+    SYS_RECEIVE_WAIT,
+    SYS_SEND_NO_WAIT,
+    SYS_RECEIVE_NO_WAIT,
+    SYS_DROP_MESSAGE,
+    SYS_WAIT,
+    SYS_SET_DEADLINE,
+    SYS_NOTIFY,
+    SYS_WAIT_NOTIFICATION,
+    SYS_CALL,
+    SYS_REPLY_WAIT,
+    SYS_SET_TASK_PARAMS,
+    SYS_SET_THRESHOLD,
+    SYS_YIELD,
+    SYS_HIRES_TIME,
+#if JOB_QUEUE_SIZE > 0
+    SYS_SUBMIT_JOB,
+    SYS_TAKE_JOB,
+#endif
+#if KERNEL_HANDLERS
+    SYS_CREATE_HANDLER,
+    SYS_ACTIVATE,
+    SYS_SET_HANDLER_TIMER,
+    SYS_NEXT_HANDLER,
+#endif
+    SYS_COUNT
+};
+
+static uintptr_t enter_kernel(uint nr, uintptr_t a, uintptr_t b);
+static uint tick_cycles(void);
+#if KERNEL_HANDLERS
+static bool handler_activate(handler *pHandler);
+#endif
+
+static bool InKernelCall = FALSE;   /* kernel_dispatch() is running */
+
+/* Earliest tick by which a task in the TimerList or WaitingList must wake
+   up, at the end of its timer slack; the tick's top half compares only
+   against this. It may be early but
+   never late: the bottom half recomputes it. */
+static uint NextEvent = NO_DEADLINE;
+
+#if TIME_SLICE_TICKS > 0
+/* The task the tick is slicing and the ticks it has run for */
+static TCB *SliceTask = NULL;
+static uint nSliceUsed = 0;
+#endif
+
+static void note_event(uint nTick) {
+    if (time_before(nTick, NextEvent)) {
+        NextEvent = nTick;
+    }
+}
+
+/* Makes the head of the ReadyList run. A kernel call switches to it on the
+   way out; an interrupt handler leaves the switch to the bottom half. */
+static void reschedule(void) {
+    if (KernelMode != RUNNING) {
+        return;
+    }
+    if (InKernelCall) {
+        NextTask = ReadyList->pHead->pTask;
+    } else {
+        request_bottom_half();
+    }
+}
+
+/* Readies a task released by the running one. A deadline no later than
+   the head's goes straight to the head of the ReadyList and runs next,
+   unless the head's preemption threshold holds it back; otherwise the head
+   keeps running and only the sorted insert is paid. */
+static void ready_released(listobj *node) {
+    if (ready_preempts(ReadyList, node->pTask)) {
+        list_link_head(ReadyList, node);
+        reschedule();
+    } else {
+        ready_insert(ReadyList, node);
+    }
+}
+
+#if TASK_POOL_SIZE > 0
+static listobj *TaskPool = NULL;    /* terminated tasks kept for reuse, by pNext */
+static int nPooled = 0;
+#endif
+
 /* idle task
-  - infinite loop created with Deadline UINT_MAX to always be last
+  - infinite loop created with NO_DEADLINE to always be last
+  - checks the stack guard words while nothing else runs
 */
 void idle_task(void) {
     while (1) {
-        //does nothing
+        stack_idle_scan();
     }
 }
 /* Init kernel
@@ -41,7 +140,7 @@ exception init_kernel(void) {
         return FAIL;
     }
 
-    exception status = create_task(idle_task, UINT_MAX);
+    exception status = create_task(idle_task, NO_DEADLINE);
     if (status != OK) {
         return FAIL;
     }
@@ -49,93 +148,143 @@ exception init_kernel(void) {
     return OK;
 }
 
+/* Builds the initial stack frame of a task so that the next context load
+   enters task_body with a clean stack */
+static void init_stack_frame(TCB *tcb, void (*task_body)()) {
+    int i;
+    tcb->PC = task_body;
+    tcb->SP = &(tcb->StackSeg [STACK_SIZE - 9]);
+    tcb->SPSR = 0x21000000;  // Default processor status register value
+
+    for (i = STACK_SIZE - 9; i < STACK_SIZE; i++) {
+        tcb->StackSeg[i] = 0;   // a recycled stack holds the old task's words
+    }
+    tcb->StackSeg[STACK_SIZE - 2] = 0x21000000;  // Set xPSR (Thread Mode, Thumb)
+    tcb->StackSeg [STACK_SIZE - 3] = (unsigned int) task_body;
+}
+
+/* Allocates a task and its list node, from the task pool if possible. A
+   recycled TCB is cleared except for StackSeg. */
+static listobj *task_alloc(void) {
+    listobj *node;
+#if TASK_POOL_SIZE > 0
+    if (TaskPool != NULL) {
+        node = TaskPool;
+        TaskPool = node->pNext;
+        nPooled--;
+        memset(node->pTask, 0, offsetof(TCB, StackSeg));
+        memset(&node->pTask->Deadline, 0, sizeof(TCB) - offsetof(TCB, Deadline));
+        node->pNext = node->pPrevious = NULL;
+        node->pMessage = NULL;
+        node->nTCnt = 0;
+        return node;
+    }
+#endif
+    node = (listobj *)calloc(1,sizeof(listobj));
+    if (node == NULL) {
+        return NULL;
+    }
+    node->pTask = (TCB *) calloc (1, sizeof(TCB));
+    if (node->pTask == NULL) {
+        free(node);
+        return NULL;
+    }
+    return node;
+}
+
+/* Keeps up to TASK_POOL_SIZE terminated tasks for task_alloc() */
+static void task_free(listobj *node) {
+#if TASK_POOL_SIZE > 0
+    if (nPooled < TASK_POOL_SIZE) {
+        node->pNext = TaskPool;
+        TaskPool = node;
+        nPooled++;
+        return;
+    }
+#endif
+    free(node->pTask);
+    free(node);
+}
+
 /* Creates a new task:
-   - Allocates a TCB and initializes its PC, Deadline, and SP.
-   - Inserts the TCB into the ReadyList.
-   - If the kernel is already running, disables interrupts and performs a context switch.
+   - Allocates a TCB from the task pool or the heap and initializes its PC,
+     Deadline, and SP.
+   - Inserts the TCB into the ReadyList, all in one kernel call.
+   - If the kernel is already running and the new task is more urgent, switches to it.
 */
 exception create_task(void (*task_body)(), uint deadline) {
-    /* Allocate memory for a new TCB */
-    TCB *new_tcb;
-    new_tcb = (TCB *) calloc (1, sizeof(TCB));
-    if (new_tcb == NULL) {
+    return (exception) enter_kernel(SYS_CREATE_TASK, (uintptr_t) task_body, deadline);
+}
+
+static uintptr_t sys_create_task(uintptr_t a, uintptr_t b) {
+    listobj *node = task_alloc();
+    if (node == NULL) {
         return FAIL;
     }
 
-    /* Initialize the TCB */
-    new_tcb->Deadline = deadline;
-    new_tcb->PC = task_body;
-    new_tcb->SP = &(new_tcb->StackSeg [STACK_SIZE - 9]);
-    new_tcb->SPSR = 0x21000000;  // Default processor status register value
-
-  
+    /* Initialize the TCB and its stack */
+    TCB *new_tcb = node->pTask;
+    new_tcb->pNode = node;
+    new_tcb->Deadline = (uint) b;
+    new_tcb->nPriority = (uint) b - ticks();
+    new_tcb->MissPolicy = MISS_CONTINUE;
+    stack_paint(new_tcb);
+    init_stack_frame(new_tcb, (void (*)()) a);
 
-    /* Initialize Stack */
-    new_tcb->StackSeg[STACK_SIZE - 2] = 0x21000000;  // Set xPSR (Thread Mode, Thumb)
-    new_tcb->StackSeg [STACK_SIZE - 3] = (unsigned int) task_body;
-    
-    listobj *node = (listobj *)calloc(1,sizeof(listobj));
-    if(node == NULL){
-      return FAIL;
-    }
-    node->pNext = node->pPrevious = NULL;
-    node->pTask = new_tcb;
-    node->nTCnt = 0;
-    
     /* Insert into ReadyList */
-    if (KernelMode == INIT) {
-        if (!list_insert_sort(ReadyList, node, cmp_tcb_priority)) {
-            free(new_tcb);
-            return FAIL;
-        }
-        return OK;
-    } else {
-        isr_off();
-        PreviousTask = NextTask; // Save the current task before switching
-        if (!list_insert_sort(ReadyList, node, cmp_tcb_priority)) {
-            isr_on();
-            free(new_tcb);
-            return FAIL;
-        }
-        
-        if(NextTask == NULL || new_tcb->Deadline < NextTask->Deadline){//if deadlines true we can assume newTCB is infact first in readylist otherwise the nexttask wont need to change
-          NextTask = ReadyList->pHead->pTask;
-          SwitchContext();
-        }
-        isr_on();
-        return OK;
+    ready_insert(ReadyList, node);
+    TRACE(TRACE_CREATE, new_tcb, new_tcb->Deadline);
+    
+    if (KernelMode == RUNNING && ReadyList->pHead == node) {
+        reschedule();
     }
+    return OK;
+}
+
+/* The calling task, for notify() */
+TCB *current_task(void) {
+    return NextTask;
 }
 
 void run(void) {
   set_ticks(0);
+  tick_cycles();
   KernelMode = RUNNING;
   NextTask = ReadyList->pHead->pTask;
+  cpu_usage_start();
+  trace_start();
   LoadContext_In_Run();
 }
 
 /* Terminates the currently running task:
-   - Disables interrupts.
+   - Traps into the kernel.
    - Frees the TCB of the current task.
    - Extracts the next task from the ReadyList.
-   - Switches to the next task's stack and loads its context.
+   - Loads the next task's context on the way out.
 */
 void terminate(void) {
-    isr_off();
+    enter_kernel(SYS_TERMINATE, 0, 0);
+}
 
+static void forget_server(listobj *server);
+
+/* Runs on the main stack, so the TCB can be freed before leaving; 
+   PreviousTask == NULL tells the port not to save the context. */
+static uintptr_t sys_terminate(uintptr_t a, uintptr_t b) {
     if (!ReadyList->pHead) {
-      isr_on();  
-      return;
+      return FAIL;
     }
 
     leavingObj = list_remove_head(ReadyList);
+    TRACE(TRACE_TERMINATE, leavingObj->pTask, 0);
+    forget_server(leavingObj);
     NextTask = ReadyList->pHead->pTask;
 
-    switch_to_stack_of_next_task();
-    free(leavingObj->pTask);
-    free(leavingObj);
-
-    LoadContext_In_Terminate();
+    cpu_usage_forget(leavingObj->pTask);
+    stack_forget(leavingObj->pTask);
+    task_free(leavingObj);
+    PreviousTask = NULL;
+    return OK;
 }
 
 mailbox* create_mailbox(uint nMessages, uint nDataSize) {
@@ -147,12 +296,154 @@ mailbox* create_mailbox(uint nMessages, uint nDataSize) {
     mBox->nMaxMessages = nMessages;
     mBox->nMessages = 0;
     mBox->nBlockedMsg = 0;
+    mBox->pHandler = NULL;
+    mBox->Server = FALSE;
+    mBox->pReceiver = NULL;
+    mBox->pNextServer = NULL;
     return mBox;
 }
 
+static mailbox *ServerBoxes = NULL;     /* the server mailboxes, by pNextServer */
+
+/* Marks mBox as the request mailbox of a server task. While the task that
+   receives on it has requests to deal with, it runs at the earliest
+   deadline of its own, of the call() it is serving and of the blocked
+   send_wait() and call() clients queued in mBox. This goes on down a
+   chain of servers: a server blocked in call() on another server mailbox
+   passes its inherited deadline on.
+   Called by a task, it also makes the task the receiver straight away;
+   otherwise the receiver is known once it first receives. */
+exception set_server_mailbox(mailbox *mBox) {
+    if (!mBox) return FAIL;
+    uint state = critical_enter();
+    if (!mBox->Server) {
+        mBox->Server = TRUE;
+        mBox->pNextServer = ServerBoxes;
+        ServerBoxes = mBox;
+    }
+    if (KernelMode == RUNNING && !handler_mode()) {
+        mBox->pReceiver = NextTask->pNode;
+    }
+    critical_exit(state);
+    return OK;
+}
+
+/* The deadline of a task without inheritance */
+static uint own_deadline(TCB *task) {
+    return task->Inherits ? task->OwnDeadline : task->Deadline;
+}
+
+static bool in_list(list *lst, listobj *node) {
+    listobj *current;
+    for (current = lst->pHead; current != NULL; current = current->pNext) {
+        if (current == node) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Moves a server whose Deadline changed to its place in the list it is in.
+   A blocked server goes behind the tasks with the same deadline: those
+   include the clients it has the deadline from, which time out first and
+   give it back its own, so it is not woken at a client's deadline. */
+static void resort_server(listobj *server) {
+    if (in_list(ReadyList, server)) {
+        list_unlink_node(ReadyList, server);
+        ready_insert(ReadyList, server);
+    } else if (in_list(WaitingList, server)) {
+        list_unlink_node(WaitingList, server);
+        list_insert_sort(WaitingList, server, cmp_tcb_deadline_behind);
+        note_event(server->pTask->Deadline);
+    } else if (in_list(TimerList, server)) {
+        list_unlink_node(TimerList, server);
+        list_insert_sort(TimerList, server, cmp_tcb_deadline_behind);
+        note_event(server->pTask->Deadline);
+    }
+}
+
+/* Recomputes the deadline of the receiver of server mailbox mBox and of
+   the servers it is blocked on in turn, see set_server_mailbox(), from
+   the clients still blocked on it. Called whenever a client arrives or
+   leaves. Moves each server to its new place in its list; the caller
+   updates NextTask. */
+static void inherit_deadline(mailbox *mBox) {
+    while (mBox != NULL && mBox->Server && mBox->pReceiver != NULL) {
+        listobj *server = mBox->pReceiver;
+        TCB *task = server->pTask;
+        uint nDeadline = own_deadline(task);
+        msg *pMsg;
+
+        if (task->pClient != NULL && time_before(task->pClient->pTask->Deadline, nDeadline)) {
+            nDeadline = task->pClient->pTask->Deadline;
+        }
+        for (pMsg = mBox->pHead; pMsg != NULL; pMsg = pMsg->pNext) {
+            // a client that has timed out leaves its message until it runs
+            if (pMsg->Status != RECEIVER && pMsg->pBlock != NULL &&
+                pMsg->pBlock->pTask->pBlockBox == mBox &&
+                time_before(pMsg->pBlock->pTask->Deadline, nDeadline)) {
+                nDeadline = pMsg->pBlock->pTask->Deadline;
+            }
+        }
+        if (nDeadline == task->Deadline) {
+            return;
+        }
+
+        if (!task->Inherits) {
+            task->OwnDeadline = task->Deadline;
+        }
+        task->Inherits = (nDeadline != task->OwnDeadline);
+        task->Deadline = nDeadline;
+        resort_server(server);
+        mBox = task->pBlockBox;
+    }
+}
+
+/* Unlinks a terminating task from the calls it takes part in: the server
+   mailboxes it received on lose their receiver, and the client whose
+   call() it is serving gets FAIL. Its node is out of the ReadyList. */
+static void forget_server(listobj *server) {
+    mailbox *mBox;
+    listobj *client = server->pTask->pClient;
+
+    for (mBox = ServerBoxes; mBox != NULL; mBox = mBox->pNextServer) {
+        if (mBox->pReceiver == server) {
+            mBox->pReceiver = NULL;
+        }
+    }
+    if (client != NULL) {
+        client->pTask->InCall = FALSE;
+        client->pTask->CallStatus = FAIL;
+        client->pTask->pServer = NULL;
+        client->pTask->pBlockBox = NULL;
+        server->pTask->pClient = NULL;
+        list_unlink_node(WaitingList, client);
+        TRACE(TRACE_UNBLOCK, client->pTask, 0);
+        ready_insert(ReadyList, client);
+    }
+}
+
+/* Gives up an inherited deadline, for a server that blocks receiving */
+static void drop_inheritance(TCB *task) {
+    if (task->Inherits) {
+        task->Deadline = task->OwnDeadline;
+        task->Inherits = FALSE;
+    }
+}
+
 exception remove_mailbox(mailbox* mBox) {
+    mailbox **ppBox;
+    uint state;
     if (!mBox) return FAIL;
     if (mBox->nMessages == 0) {
+        state = critical_enter();
+        for (ppBox = &ServerBoxes; *ppBox != NULL; ppBox = &(*ppBox)->pNextServer) {
+            if (*ppBox == mBox) {
+                *ppBox = mBox->pNextServer;
+                break;
+            }
+        }
+        critical_exit(state);
         free(mBox);
         return OK;
     }
@@ -160,21 +451,62 @@ exception remove_mailbox(mailbox* mBox) {
 }
 
 exception send_wait(mailbox* mBox, void* pData) {
-    isr_off();
+    exception status = (exception) enter_kernel(SYS_SEND_WAIT, (uintptr_t) mBox, (uintptr_t) pData);
+    if (status != OK) {
+        return status;
+    }
 
-    // If a receiver is waiting, deliver the message immediately
-    if (mBox->pHead && mBox->pHead->Status == RECEIVER) {
-        memcpy(mBox->pHead->pData, pData, mBox->nDataSize);
-        msg *receivedMsg = mailbox_remove_head(mBox);
+    // Runs again once the message was taken, or the deadline is reached
+    if (time_reached(deadline())) {
+        enter_kernel(SYS_DROP_MESSAGE, (uintptr_t) mBox, 0);
+        return DEADLINE_REACHED;
+    }else{
+        return OK;
+    }
+}
+
+/* Drops the entries at the head of mBox whose tasks no longer wait on
+   it: a task released by its deadline leaves its entry until it runs
+   again, see cancel_waits(), and its list node is not in the WaitingList
+   any more. A late message is not handed to it. */
+static void drop_stale(mailbox *mBox) {
+    while (mBox->pHead != NULL && mBox->pHead->pBlock != NULL &&
+           mBox->pHead->pBlock->pTask->pBlockBox != mBox) {
+        msg *expiredMsg = mailbox_remove_head(mBox);
         mBox->nBlockedMsg--;
-        free(receivedMsg);
+        if (expiredMsg->Status != RECEIVER) {
+            free(expiredMsg->pData);
+        }
+        free(expiredMsg);
+    }
+}
 
-        // Move the receiving task to the ReadyList
-        PreviousTask = NextTask;
-        listobj *WaitHead = list_remove_head(WaitingList);
-        list_insert_sort(ReadyList, WaitHead,cmp_tcb_priority);
-        NextTask = ReadyList->pHead->pTask;
-    }else{
+/* Copies pData into the buffer of the receiver waiting at the head of
+   mBox and readies it. Returns FALSE if no receiver is waiting. */
+static bool deliver(mailbox *mBox, void *pData) {
+    drop_stale(mBox);
+    if (mBox->pHead == NULL || mBox->pHead->Status != RECEIVER) {
+        return FALSE;
+    }
+    memcpy(mBox->pHead->pData, pData, mBox->nDataSize);
+    msg *receivedMsg = mailbox_remove_head(mBox);
+    mBox->nBlockedMsg--;
+
+    // Move the receiving task to the ReadyList
+    listobj *WaitHead = list_unlink_node(WaitingList, receivedMsg->pBlock);
+    WaitHead->pTask->pBlockBox = NULL;
+    free(receivedMsg);      // its pData is the receiver's own buffer
+    TRACE(TRACE_UNBLOCK, WaitHead->pTask, mBox);
+    ready_released(WaitHead);
+    return TRUE;
+}
+
+static uintptr_t sys_send_wait(uintptr_t a, uintptr_t b) {
+    mailbox *mBox = (mailbox *) a;
+    void *pData = (void *) b;
+
+    // If a receiver is waiting, deliver the message immediately
+    if (!deliver(mBox, pData)) {
         // No receiver -> Block sender
       msg* newMsg = (msg*)malloc(sizeof(msg));
       if (!newMsg) {
@@ -196,156 +528,360 @@ exception send_wait(mailbox* mBox, void* pData) {
       mBox->nBlockedMsg++;
   
       // Move sender task to `WaitingList` (Blocking it)
-      PreviousTask = NextTask;
       listobj *node = list_remove_head(ReadyList);
-      list_insert_sort(WaitingList, node, cmp_tcb_priority);
+      TRACE(TRACE_BLOCK, node->pTask, mBox);
+      list_insert_sort(WaitingList, node, cmp_tcb_deadline);
+      note_event(node->pTask->Deadline);
+      node->pTask->pBlockBox = mBox;
+      if (mBox->Server) {
+          inherit_deadline(mBox);
+      }
   
       NextTask = ReadyList->pHead->pTask;
     }
-    SwitchContext(); //for some reason we get tb5 in both lists her
+    return OK;
+}
 
-    // If the task remains blocked until its deadline is reached
-    if (deadline() <= Ticks) {
-        isr_off();
-        msg *expiredMsg = mailbox_remove_head(mBox);
-        free(expiredMsg);
-        isr_on();
-        return DEADLINE_REACHED;
-    }else{
-        return OK;
+/* Takes back the message of a send_wait or receive_wait whose deadline
+   expired while it was blocked. The task is running again, so its list
+   node is the head of the ReadyList. */
+static uintptr_t sys_drop_message(uintptr_t a, uintptr_t b) {
+    mailbox *mBox = (mailbox *) a;
+    msg *expiredMsg = mBox->pHead;
+    NextTask->pBlockBox = NULL;
+    while (expiredMsg != NULL && expiredMsg->pBlock != ReadyList->pHead) {
+        expiredMsg = expiredMsg->pNext;
     }
+    if (expiredMsg == NULL) {
+        return OK;      // delivered after all
+    }
+    mailbox_unlink(mBox, expiredMsg);
+    mBox->nBlockedMsg--;
+    if (expiredMsg->Status != RECEIVER) {
+        free(expiredMsg->pData);
+    }
+    free(expiredMsg);
+    inherit_deadline(mBox);
+    NextTask = ReadyList->pHead->pTask;
+    return OK;
 }
 
 
 
 exception receive_wait(mailbox* mBox, void* pData) {
-    isr_off();
+    exception status = (exception) enter_kernel(SYS_RECEIVE_WAIT, (uintptr_t) mBox, (uintptr_t) pData);
+    if (status != OK) {
+        return status;
+    }
 
-    if (mBox->pHead) {
-        msg *receivedMsg = mailbox_remove_head(mBox);
-        if (!receivedMsg) {
-            isr_on();
-            return FAIL;
-        }
+    // Check if deadline is reached; a server's own, not one it inherited
+    if (time_reached(own_deadline(NextTask))) {
+        enter_kernel(SYS_DROP_MESSAGE, (uintptr_t) mBox, 0);
+        return DEADLINE_REACHED;
+    }
+    return OK;
+}
+
+/* Links a server to the client whose request it has taken */
+static void serve(listobj *server, listobj *client) {
+    server->pTask->pClient = client;
+    client->pTask->pServer = server;
+}
+
+/* Takes the oldest message of mBox into pData and frees the kernel's copy
+   of it. Its blocked sender is readied; a caller stays blocked as the
+   client of the running task until the reply. Returns FALSE if mBox holds
+   no message, only receivers waiting for one. */
+static bool take_message(mailbox *mBox, void *pData) {
+    drop_stale(mBox);
+    if (mBox->pHead == NULL || mBox->pHead->Status == RECEIVER) {
+        return FALSE;
+    }
+
+    msg *receivedMsg = mailbox_remove_head(mBox);
+    memcpy(pData, receivedMsg->pData, mBox->nDataSize);
 
-        memcpy(pData, receivedMsg->pData, mBox->nDataSize);
+    if (receivedMsg->Status == CALLER) {
+        // The caller stays blocked until the reply, see reply_wait()
+        serve(ReadyList->pHead, receivedMsg->pBlock);
+        mBox->nBlockedMsg--;
+    } else if(receivedMsg->pBlock != NULL) {
+        listobj *node = list_unlink_node(WaitingList,receivedMsg->pBlock);
+        node->pTask->pBlockBox = NULL;
+        TRACE(TRACE_UNBLOCK, node->pTask, mBox);
+        ready_released(node);
+        mBox->nBlockedMsg--;
+    }
+    free(receivedMsg->pData);
+    free(receivedMsg);
+    return TRUE;
+}
 
-        if(mBox->nBlockedMsg > 0) {
-            PreviousTask = NextTask;
-            listobj *node = list_unlink_node(WaitingList,receivedMsg->pBlock);
-            list_insert_sort(ReadyList, node, cmp_tcb_priority);
+static uintptr_t sys_receive_wait(uintptr_t a, uintptr_t b) {
+    mailbox *mBox = (mailbox *) a;
+    void *pData = (void *) b;
+
+    if (take_message(mBox, pData)) {
+        if (mBox->Server) {
+            mBox->pReceiver = ReadyList->pHead;
+            inherit_deadline(mBox);
             NextTask = ReadyList->pHead->pTask;
-            mBox->nBlockedMsg--;
-        } else {
-            free(receivedMsg->pData);
-            free(receivedMsg);
         }
     }else{
         msg* newMsg = (msg*)malloc(sizeof(msg));
         if (!newMsg) {
-            isr_on();
             return FAIL;
         }
 
-        newMsg->pData = malloc(mBox->nDataSize);
-        if (!newMsg->pData) {
-            free(newMsg);
-            isr_on();
-            return FAIL;
-        }
-        
+        // The sender copies straight into the receiver's buffer
+        newMsg->pData = pData;
         newMsg->Status = RECEIVER;
         newMsg->pBlock = ReadyList->pHead;
 
         mailbox_insert_tail(mBox, newMsg);
-        PreviousTask = NextTask;
+        mBox->nBlockedMsg++;
+        TRACE(TRACE_BLOCK, NextTask, mBox);
+        NextTask->pBlockBox = mBox;
+        if (mBox->Server) {
+            mBox->pReceiver = ReadyList->pHead;
+        }
+        drop_inheritance(NextTask);
         
-        list_insert_sort(WaitingList, list_remove_head(ReadyList), cmp_tcb_priority);
+        list_insert_sort(WaitingList, list_remove_head(ReadyList), cmp_tcb_deadline);
+        note_event(NextTask->Deadline);
 
         NextTask = ReadyList->pHead->pTask;
     }
-    SwitchContext();
+    return OK;
+}
+
+/* Sends a request to the server receiving on mBox and blocks until the
+   server answers with reply_wait(), in one kernel call. A server blocked
+   in receive_wait() or reply_wait() runs straight away with the request.
+   Returns DEADLINE_REACHED if the deadline expires before the reply, and
+   FAIL if the server serving it terminates without replying. */
+exception call(mailbox *mBox, void *pRequest, void *pReply) {
+    void *arg[2];
+    arg[0] = pRequest;
+    arg[1] = pReply;
+    exception status = (exception) enter_kernel(SYS_CALL, (uintptr_t) mBox, (uintptr_t) arg);
+    if (status != OK) {
+        return status;
+    }
+    status = NextTask->CallStatus;
+    if (status != OK) {
+        enter_kernel(SYS_DROP_MESSAGE, (uintptr_t) mBox, 0);
+    }
+    return status;
+}
 
-    // Check if deadline is reached
-    if (PreviousTask->Deadline <= Ticks) {
-        isr_off();
-        msg *expiredMsg = mailbox_remove_head(mBox);
-        if (expiredMsg) {
-            free(expiredMsg);
+static uintptr_t sys_call(uintptr_t a, uintptr_t b) {
+    mailbox *mBox = (mailbox *) a;
+    void **arg = (void **) b;
+    msg *newMsg = NULL;
+    listobj *server = NULL;
+
+    drop_stale(mBox);
+    if (mBox->pHead && mBox->pHead->Status == RECEIVER) {
+        msg *receiverMsg = mailbox_remove_head(mBox);
+        mBox->nBlockedMsg--;
+        memcpy(receiverMsg->pData, arg[0], mBox->nDataSize);
+        server = list_unlink_node(WaitingList, receiverMsg->pBlock);
+        server->pTask->pBlockBox = NULL;
+        free(receiverMsg);
+    } else {
+        // No server waiting -> queue the request
+        newMsg = (msg *) malloc(sizeof(msg));
+        if (!newMsg) {
+            return FAIL;
+        }
+        newMsg->pData = malloc(mBox->nDataSize);
+        if (!newMsg->pData) {
+            free(newMsg);
+            return FAIL;
         }
-        isr_on();
+        memcpy(newMsg->pData, arg[0], mBox->nDataSize);
+        newMsg->Status = CALLER;
+    }
+
+    // Block the client until the reply
+    listobj *client = list_remove_head(ReadyList);
+    client->pTask->InCall = TRUE;
+    client->pTask->pReply = arg[1];
+    client->pTask->CallStatus = DEADLINE_REACHED;
+    TRACE(TRACE_BLOCK, client->pTask, mBox);
+    list_insert_sort(WaitingList, client, cmp_tcb_deadline);
+    note_event(client->pTask->Deadline);
+
+    if (server != NULL) {
+        serve(server, client);
+        TRACE(TRACE_UNBLOCK, server->pTask, mBox);
+        ready_insert(ReadyList, server);
+    } else {
+        newMsg->pBlock = client;
+        mailbox_insert_tail(mBox, newMsg);
+        mBox->nBlockedMsg++;
+    }
+    client->pTask->pBlockBox = mBox;
+    if (mBox->Server) {
+        inherit_deadline(mBox);
+    }
+    NextTask = ReadyList->pHead->pTask;
+    return OK;
+}
+
+/* Answers the call() being served with pReply and receives the next
+   request into pRequest, like receive_wait(), in one kernel call. */
+exception reply_wait(mailbox *mBox, void *pReply, void *pRequest) {
+    void *arg[2];
+    arg[0] = pReply;
+    arg[1] = pRequest;
+    exception status = (exception) enter_kernel(SYS_REPLY_WAIT, (uintptr_t) mBox, (uintptr_t) arg);
+    if (status != OK) {
+        return status;
+    }
+
+    if (time_reached(own_deadline(NextTask))) {
+        enter_kernel(SYS_DROP_MESSAGE, (uintptr_t) mBox, 0);
         return DEADLINE_REACHED;
     }
     return OK;
 }
 
+static uintptr_t sys_reply_wait(uintptr_t a, uintptr_t b) {
+    mailbox *mBox = (mailbox *) a;
+    void **arg = (void **) b;
+    listobj *client = NextTask->pClient;
+    uintptr_t status;
+
+    // The client's call() is answered even if the receive fails
+    if (client != NULL) {
+        memcpy(client->pTask->pReply, arg[0], mBox->nDataSize);
+        client->pTask->InCall = FALSE;
+        client->pTask->CallStatus = OK;
+        client->pTask->pServer = NULL;
+        client->pTask->pBlockBox = NULL;
+        NextTask->pClient = NULL;
+        list_unlink_node(WaitingList, client);
+    }
+
+    // Receive first: it expects the server at the head of the ReadyList
+    status = sys_receive_wait(a, (uintptr_t) arg[1]);
+
+    if (client != NULL) {
+        TRACE(TRACE_UNBLOCK, client->pTask, mBox);
+        ready_released(client);
+    }
+    return status;
+}
+
 exception send_no_wait(mailbox *mBox, void *pData) {
-    isr_off();
+    return (exception) enter_kernel(SYS_SEND_NO_WAIT, (uintptr_t) mBox, (uintptr_t) pData);
+}
+
+static uintptr_t sys_send_no_wait(uintptr_t a, uintptr_t b) {
+    mailbox *mBox = (mailbox *) a;
+    void *pData = (void *) b;
+
+    // A waiting receiver takes the message straight away
+    if (deliver(mBox, pData)) {
+        return OK;
+    }
 
-    // If the mailbox is full, remove the oldest message
-    if (mBox->nMessages == mBox->nMaxMessages) {
-        msg *oldMsg = mailbox_remove_head(mBox);
+    // If the mailbox is full, remove the oldest message nobody waits for;
+    // the messages of blocked senders and callers stay
+    if (mBox->nMessages >= mBox->nMaxMessages) {
+        msg *oldMsg = mBox->pHead;
+        while (oldMsg != NULL && oldMsg->pBlock != NULL) {
+            oldMsg = oldMsg->pNext;
+        }
+        if (oldMsg == NULL) {
+            return FAIL;
+        }
+        mailbox_unlink(mBox, oldMsg);
         free(oldMsg->pData);
         free(oldMsg);
     }
 
     msg* newMsg = malloc(sizeof(msg));
     if (!newMsg) {
-        isr_on();
         return FAIL;
     }
 
     newMsg->pData = malloc(mBox->nDataSize);
     if (!newMsg->pData) {
         free(newMsg);
-        isr_on();
         return FAIL;
     }
 
     memcpy(newMsg->pData, pData, mBox->nDataSize);
+    newMsg->Status = SENDER;
+    newMsg->pBlock = NULL;      // nobody waits for it
 
     // Add new message
     mailbox_insert_tail(mBox, newMsg);
 
-    isr_on();
+#if KERNEL_HANDLERS
+    if (mBox->pHandler != NULL && handler_activate(mBox->pHandler)) {
+        reschedule();
+    }
+#endif
     return OK;
 }
 
 
 int receive_no_wait(mailbox* mBox, void* pData) {
-    isr_off();
-    if (!mBox->pHead || mBox->nMessages == 0) {
-        isr_on();
-        return FAIL;
-    }
+    return (int) enter_kernel(SYS_RECEIVE_NO_WAIT, (uintptr_t) mBox, (uintptr_t) pData);
+}
 
-    msg* oldMsg = mailbox_remove_head(mBox);
-    if (!oldMsg) {
-        isr_on();
-        return FAIL;
-    }
+/* Like receive_wait() with a message waiting; a waiting receiver's entry
+   is not a message */
+static uintptr_t sys_receive_no_wait(uintptr_t a, uintptr_t b) {
+    return take_message((mailbox *) a, (void *) b) ? OK : FAIL;
+}
 
-    memcpy(pData, oldMsg->pData, mBox->nDataSize);
-    free(oldMsg->pData);
-    free(oldMsg);
+exception wait(uint nTicks) {
+    return wait_slack(nTicks, NextTask->nSlack);
+}
 
-    isr_on();
+/* Waits at least nTicks and at most nTicks + nSlack ticks. Within that
+   window the tick wakes the task together with any other wakeup, so
+   tasks with similar periods share one bottom half and idle periods get
+   longer. The window is cut so that the task still has its nWcet (see
+   set_task_params) before its deadline. */
+exception wait_slack(uint nTicks, uint nSlack) {
+    enter_kernel(SYS_WAIT, nTicks, nSlack);
+    if (time_reached(deadline())) {
+        return DEADLINE_REACHED;
+    }
     return OK;
 }
 
-exception wait(uint nTicks) {
-    isr_off();
-    PreviousTask = NextTask;
+/* The slack of the calling task's wait() calls, 0 by default */
+void set_timer_slack(uint nSlack) {
+    NextTask->nSlack = nSlack;
+}
+
+/* Latest tick to end a wait() until nTCnt with nSlack ticks of slack */
+static uint wake_by(TCB *task, uint nTCnt, uint nSlack) {
+    uint nLatest = nTCnt + nSlack;
+    if (task->Deadline < DEMOTED_DEADLINE &&
+        time_before(task->Deadline - task->nWcet, nLatest)) {
+        nLatest = task->Deadline - task->nWcet;
+    }
+    return time_before(nTCnt, nLatest) ? time_valid(nLatest) : nTCnt;
+}
+
+static uintptr_t sys_wait(uintptr_t a, uintptr_t b) {
     listobj* node = list_remove_head(ReadyList);
-    node->nTCnt = nTicks + ticks();
-    list_insert_sort(TimerList, node,cmp_tcb_priority);
+    node->nTCnt = time_valid((uint) a + ticks());
+    node->pTask->nWakeBy = wake_by(node->pTask, node->nTCnt, (uint) b);
+    TRACE(TRACE_BLOCK, node->pTask, 0);
+    list_insert_sort(TimerList, node, cmp_tcb_deadline);
+    note_event(node->pTask->nWakeBy);
+    note_event(node->pTask->Deadline);
     
     NextTask = ReadyList->pHead->pTask;
-    
-    SwitchContext();
-    if (ticks() >= deadline()) {
-        return DEADLINE_REACHED;
-    }
     return OK;
 }
 
@@ -362,44 +898,814 @@ uint deadline(void) {
 }
 
 void set_deadline(uint deadline) {
-    isr_off();
-    NextTask->Deadline = deadline;
-    PreviousTask = NextTask;
-    list_remove_head(ReadyList);
-    list_insert_sort(ReadyList, ReadyList->pHead, cmp_tcb_priority);
+    enter_kernel(SYS_SET_DEADLINE, deadline, 0);
+}
+
+static uintptr_t sys_set_deadline(uintptr_t a, uintptr_t b) {
+    NextTask->Deadline = (uint) a;
+    NextTask->nUsed = 0;        // a new job
+    NextTask->Inherits = FALSE;
+    NextTask->Missed = FALSE;
+    listobj *node = list_remove_head(ReadyList);
+    ready_insert(ReadyList, node);
+    NextTask = ReadyList->pHead->pTask;
+    return OK;
+}
+
+/* High-resolution time.
+   hires_time() adds the part of the current tick that the SysTick down
+   counter has run to Ticks whole ticks. The counter reloads before
+   TimerInt increments Ticks: a reload seen as a pending SysTick counts as
+   the next tick, with the counter read again after it, and a TimerInt
+   between the reads is retried. The wraps of Ticks are counted, so the
+   time does not wrap with it. The counter is privileged, so tasks read it
+   in a kernel call. The scheduler still works in ticks: deadlines given
+   in cycles are rounded up to the tick. */
+static uint nTickCycles = 0;        /* SysTick cycles per tick */
+static uint nTickWraps = 0;         /* times Ticks has wrapped to 0 */
+
+/* Read once in privileged mode: by run(), or by main() before it */
+static uint tick_cycles(void) {
+    if (nTickCycles == 0) {
+        nTickCycles = systick_reload() + 1;
+    }
+    return nTickCycles;
+}
+
+hires hires_time(void) {
+    hires t;
+    enter_kernel(SYS_HIRES_TIME, (uintptr_t) &t, 0);
+    return t;
+}
+
+static uintptr_t sys_hires_time(uintptr_t a, uintptr_t b) {
+    uint nWraps, nTick, nCount, nReload = systick_reload();
+    do {
+        nTick = Ticks;
+        nWraps = nTickWraps;
+        nCount = systick_count();
+        if (systick_pending()) {
+            nCount = systick_count();
+            if (++nTick == 0) {
+                nWraps++;
+            }
+        }
+    } while (Ticks != nTick && Ticks != nTick - 1);  // TimerInt ran
+    *(hires *) a = (((hires) nWraps << 32) | nTick) * (nReload + 1) + (nReload - nCount);
+    return OK;
+}
+
+hires ticks_to_hires(uint nTicks) {
+    return (hires) nTicks * tick_cycles();
+}
+
+/* The first tick at or after t */
+uint hires_to_ticks(hires t) {
+    return (uint) ((t + tick_cycles() - 1) / tick_cycles());
+}
+
+void set_deadline_hires(hires t) {
+    set_deadline(hires_to_ticks(t));
+}
+
+/* Sleeps until the tick in which t falls, then polls hires_time() for the
+   rest. The sleep takes no timer slack, whatever set_timer_slack() gave
+   the caller, so it ends at the start of that tick and the poll lasts less
+   than one tick. The poll is busy, one kernel call per hires_time(): for
+   up to that tick no task with the same key runs, and only a more urgent
+   task preempts the caller.
+   A caller that wakes late finds t passed and does not poll at all. */
+exception wait_until_hires(hires t) {
+    uint nTick = (uint) (t / tick_cycles());
+    if (time_before(ticks(), nTick)) {
+        wait_slack(nTick - ticks(), 0);
+    }
+    while (hires_time() < t && !time_reached(deadline())) {}
+    if (time_reached(deadline())) {
+        return DEADLINE_REACHED;
+    }
+    return OK;
+}
+
+#if JOB_QUEUE_SIZE > 0
+/* Job workers blocked for lack of jobs, as RECEIVER messages whose pData is
+   the worker's job record */
+static mailbox IdleWorkers;
+
+/* Takes the earliest job and runs it at the job's deadline. While the job
+   queue is empty the worker waits in the WaitingList with NO_DEADLINE,
+   behind every task that can time out. */
+static void job_worker(void) {
+    job current;
+    msg idle;
+    while (1) {
+        enter_kernel(SYS_TAKE_JOB, (uintptr_t) &current, (uintptr_t) &idle);
+        current.pFunction(current.pArg);
+    }
+}
+
+/* Creates nWorkers job workers. They start with the deadline of the current
+   tick, so that they block for jobs before any other task runs. */
+exception start_job_workers(uint nWorkers) {
+    while (nWorkers-- > 0) {
+        if (create_task(job_worker, ticks()) != OK) {
+            return FAIL;
+        }
+    }
+    return OK;
+}
+
+/* Hands a job to an idle worker, or queues it until a worker finishes its
+   job. A busy worker keeps the deadline of its current job, so a queued
+   job runs at the earliest when a worker is done. Returns FAIL if
+   JOB_QUEUE_SIZE jobs are already queued. Callable from interrupt
+   handlers masked by critical sections, see critical.h. */
+exception submit_job(void (*pFunction)(void *), void *pArg, uint deadline) {
+    job newJob;
+    newJob.pFunction = pFunction;
+    newJob.pArg = pArg;
+    newJob.Deadline = deadline;
+    newJob.pNext = NULL;
+    return (exception) enter_kernel(SYS_SUBMIT_JOB, (uintptr_t) &newJob, 0);
+}
+
+static uintptr_t sys_submit_job(uintptr_t a, uintptr_t b) {
+    job *pJob = (job *) a;
+    msg *idle = mailbox_remove_head(&IdleWorkers);
+    if (idle != NULL) {
+        memcpy(idle->pData, pJob, sizeof(job));
+        listobj *node = list_unlink_node(WaitingList, idle->pBlock);
+        node->pTask->Deadline = pJob->Deadline;
+        TRACE(TRACE_UNBLOCK, node->pTask, &IdleWorkers);
+        ready_released(node);
+        return OK;
+    }
+
+    job *queued = job_alloc();
+    if (queued == NULL) {
+        return FAIL;
+    }
+    memcpy(queued, pJob, sizeof(job));
+    job_insert_sort(queued);
+    return OK;
+}
+
+/* Called by the running worker between jobs */
+static uintptr_t sys_take_job(uintptr_t a, uintptr_t b) {
+    job *pJob = (job *) a;
+    job *next = job_remove_head();
+    listobj *node = list_remove_head(ReadyList);
+
+    node->pTask->Missed = FALSE;
+    if (next != NULL) {
+        memcpy(pJob, next, sizeof(job));
+        job_free(next);
+        node->pTask->Deadline = pJob->Deadline;
+        ready_insert(ReadyList, node);
+    } else {
+        msg *idle = (msg *) b;
+        idle->pData = (char *) pJob;
+        idle->Status = RECEIVER;
+        idle->pBlock = node;
+        mailbox_insert_tail(&IdleWorkers, idle);
+        node->pTask->Deadline = NO_DEADLINE;
+        TRACE(TRACE_BLOCK, node->pTask, &IdleWorkers);
+        list_insert_sort(WaitingList, node, cmp_tcb_deadline);
+    }
     NextTask = ReadyList->pHead->pTask;
-    SwitchContext();
-    isr_on();
+    return OK;
+}
+#endif
+
+#if KERNEL_HANDLERS
+/* Run-to-completion handlers.
+   All handlers run in one dispatcher task, so they share its TCB and
+   stack: the dispatcher calls the earliest pending handler and, when it
+   returns, the next one, with no context switch in between. The
+   dispatcher runs at the deadline of the earliest pending activation, so
+   it competes with the tasks under EDF. A handler is not preempted by a
+   more urgent handler; that one runs as soon as it returns, which keeps
+   the shared stack one handler deep. Handlers must not block. */
+static listobj *Dispatcher = NULL;      /* its node once it has run */
+static bool DispatcherIdle = FALSE;     /* blocked in the WaitingList */
+static bool DispatcherCreated = FALSE;
+
+static void handler_dispatcher(void) {
+    handler *pHandler;
+    while (1) {
+        pHandler = (handler *) enter_kernel(SYS_NEXT_HANDLER, 0, 0);
+        if (pHandler != NULL) {
+            pHandler->pFunction(pHandler->pArg);
+        }
+    }
+}
+
+/* Records an activation with its own deadline and makes the dispatcher
+   compete at it. An activation beyond HANDLER_PENDING_MAX pending ones is
+   dropped. Returns TRUE if the ReadyList changed and the caller must
+   reschedule. */
+static bool handler_activate(handler *pHandler) {
+    uint nDeadline = time_valid(ticks() + pHandler->nRelDeadline);
+    if (pHandler->nPending == HANDLER_PENDING_MAX) {
+        return FALSE;
+    }
+    pHandler->PendingDeadline[(pHandler->nFirstPending + pHandler->nPending) %
+                              HANDLER_PENDING_MAX] = nDeadline;
+    if (pHandler->nPending++ == 0) {
+        pHandler->Deadline = nDeadline;
+        handler_insert_pending(pHandler);
+    }
+    if (Dispatcher == NULL || !time_before(nDeadline, Dispatcher->pTask->Deadline)) {
+        return FALSE;
+    }
+    if (DispatcherIdle) {
+        list_unlink_node(WaitingList, Dispatcher);
+        DispatcherIdle = FALSE;
+        TRACE(TRACE_UNBLOCK, Dispatcher->pTask, 0);
+    } else {
+        list_unlink_node(ReadyList, Dispatcher);
+    }
+    Dispatcher->pTask->Deadline = nDeadline;
+    ready_insert(ReadyList, Dispatcher);
+    return TRUE;
+}
+
+/* Allocates a handler whose activations must complete within nRelDeadline
+   ticks. The first handler creates the dispatcher task; it starts with the
+   deadline of the current tick to block before any other task runs. */
+handler *create_handler(void (*pFunction)(void *), void *pArg, uint nRelDeadline) {
+    handler *pHandler = calloc(1, sizeof(handler));
+    if (pHandler == NULL) {
+        return NULL;
+    }
+    pHandler->pFunction = pFunction;
+    pHandler->pArg = pArg;
+    pHandler->nRelDeadline = nRelDeadline;
+    if (enter_kernel(SYS_CREATE_HANDLER, 0, 0) != OK) {
+        free(pHandler);
+        return NULL;
+    }
+    return pHandler;
+}
+
+static uintptr_t sys_create_handler(uintptr_t a, uintptr_t b) {
+    if (DispatcherCreated) {
+        return OK;
+    }
+    if (sys_create_task((uintptr_t) handler_dispatcher, ticks()) != OK) {
+        return FAIL;
+    }
+    DispatcherCreated = TRUE;
+    return OK;
+}
+
+/* Runs pHandler once more, within its relative deadline from now. Returns
+   FAIL if HANDLER_PENDING_MAX activations of it have not run yet.
+   Callable from interrupt handlers masked by critical sections, see
+   critical.h. */
+exception activate(handler *pHandler) {
+    return (exception) enter_kernel(SYS_ACTIVATE, (uintptr_t) pHandler, 0);
+}
+
+static uintptr_t sys_activate(uintptr_t a, uintptr_t b) {
+    handler *pHandler = (handler *) a;
+    if (pHandler->nPending == HANDLER_PENDING_MAX) {
+        return FAIL;
+    }
+    if (handler_activate(pHandler)) {
+        reschedule();
+    }
+    return OK;
 }
 
+/* Activates pHandler nDelay ticks from now and then every nPeriod ticks,
+   or once if nPeriod is 0. nDelay 0 stops the timer. */
+exception set_handler_timer(handler *pHandler, uint nDelay, uint nPeriod) {
+    uint timer[2];
+    timer[0] = nDelay;
+    timer[1] = nPeriod;
+    return (exception) enter_kernel(SYS_SET_HANDLER_TIMER, (uintptr_t) pHandler, (uintptr_t) timer);
+}
+
+static uintptr_t sys_set_handler_timer(uintptr_t a, uintptr_t b) {
+    handler *pHandler = (handler *) a;
+    uint *timer = (uint *) b;
+    if (pHandler->TimerArmed) {
+        handler_unlink_timer(pHandler);
+    }
+    if (timer[0] == 0) {
+        return OK;
+    }
+    pHandler->nTimer = time_valid(ticks() + timer[0]);
+    pHandler->nPeriod = timer[1];
+    handler_insert_timer(pHandler);
+    note_event(pHandler->nTimer);
+    return OK;
+}
+
+/* Software timers. A timer is a handler that only its timer activates:
+   the callback runs in the dispatcher at TIMER_SERVICE_DEADLINE ticks
+   after each expiry, so any number of timers shares one TCB and stack,
+   and the tick sees only the earliest of them through NextEvent. An
+   expiry while HANDLER_PENDING_MAX callbacks are still pending is lost.
+   The callback must not block. */
+handler *create_timer(void (*pCallback)(void *), void *pArg) {
+    return create_handler(pCallback, pArg, TIMER_SERVICE_DEADLINE);
+}
+
+/* Calls back nDelay ticks from now and then every nPeriod ticks, or once
+   if nPeriod is 0; restarts a running timer. */
+exception start_timer(handler *pTimer, uint nDelay, uint nPeriod) {
+    if (pTimer == NULL || nDelay == 0) {
+        return FAIL;
+    }
+    return set_handler_timer(pTimer, nDelay, nPeriod);
+}
+
+/* An expiry whose callback has not run yet still runs it */
+exception stop_timer(handler *pTimer) {
+    if (pTimer == NULL) {
+        return FAIL;
+    }
+    return set_handler_timer(pTimer, 0, 0);
+}
+
+/* Each message sent to mBox with send_no_wait activates pHandler, which
+   takes it with receive_no_wait. */
+exception bind_handler(mailbox *mBox, handler *pHandler) {
+    if (mBox == NULL) {
+        return FAIL;
+    }
+    mBox->pHandler = pHandler;
+    return OK;
+}
+
+/* Called by the running dispatcher between handlers: returns the earliest
+   pending handler and runs the dispatcher at its deadline, or blocks the
+   dispatcher and returns NULL if there is none. */
+static uintptr_t sys_next_handler(uintptr_t a, uintptr_t b) {
+    handler *pHandler = handler_remove_pending();
+    listobj *node = list_remove_head(ReadyList);
+
+    Dispatcher = node;
+    node->pTask->Missed = FALSE;
+    if (pHandler != NULL) {
+        node->pTask->Deadline = pHandler->Deadline;
+        pHandler->nFirstPending = (pHandler->nFirstPending + 1) % HANDLER_PENDING_MAX;
+        if (--pHandler->nPending > 0) {
+            pHandler->Deadline = pHandler->PendingDeadline[pHandler->nFirstPending];
+            handler_insert_pending(pHandler);
+        }
+        ready_insert(ReadyList, node);
+    } else {
+        node->pTask->Deadline = NO_DEADLINE;
+        DispatcherIdle = TRUE;
+        TRACE(TRACE_BLOCK, node->pTask, 0);
+        list_insert_sort(WaitingList, node, cmp_tcb_deadline);
+    }
+    NextTask = ReadyList->pHead->pTask;
+    return (uintptr_t) pHandler;
+}
+
+/* Activates the handlers whose timers are due; from TimerBottomHalf */
+static void handler_timers(void) {
+    handler *pHandler;
+    while (TimerHandlers != NULL && time_reached(TimerHandlers->nTimer)) {
+        pHandler = TimerHandlers;
+        handler_unlink_timer(pHandler);
+        if (pHandler->nPeriod != 0) {
+            pHandler->nTimer = time_valid(pHandler->nTimer + pHandler->nPeriod);
+            handler_insert_timer(pHandler);
+        }
+        handler_activate(pHandler);
+    }
+}
+#endif
+
+/* Updates the notification word of pTask with eAction and releases pTask
+   if it is blocked in wait_notification(). Callable from interrupt
+   handlers masked by critical sections, see critical.h. */
+exception notify(TCB *pTask, uint nValue, action eAction) {
+    uint arg[2];
+    arg[0] = nValue;
+    arg[1] = eAction;
+    return (exception) enter_kernel(SYS_NOTIFY, (uintptr_t) pTask, (uintptr_t) arg);
+}
+
+static uintptr_t sys_notify(uintptr_t a, uintptr_t b) {
+    TCB *pTask = (TCB *) a;
+    uint *arg = (uint *) b;
+    switch (arg[1]) {
+    case NOTIFY_SET_BITS:
+        pTask->nNotify |= arg[0];
+        break;
+    case NOTIFY_INCREMENT:
+        pTask->nNotify += arg[0];
+        break;
+    case NOTIFY_OVERWRITE:
+        pTask->nNotify = arg[0];
+        break;
+    default:
+        return FAIL;
+    }
+    if (!pTask->NotifyWait) {
+        pTask->NotifyPending = TRUE;
+        return OK;
+    }
+
+    // Hand the word straight to the blocked task
+    *pTask->pNotifyValue = pTask->nNotify;
+    pTask->nNotify = 0;
+    pTask->NotifyWait = FALSE;
+    pTask->NotifyStatus = OK;
+    list_unlink_node(WaitingList, pTask->pNode);
+    TRACE(TRACE_UNBLOCK, pTask, 0);
+    ready_released(pTask->pNode);
+    return OK;
+}
+
+/* Takes the notification word of the calling task into *pValue and clears
+   it, blocking until a notify() if none is pending. Returns
+   DEADLINE_REACHED if the deadline expires first. */
+exception wait_notification(uint *pValue) {
+    enter_kernel(SYS_WAIT_NOTIFICATION, (uintptr_t) pValue, 0);
+    return NextTask->NotifyStatus;
+}
+
+static uintptr_t sys_wait_notification(uintptr_t a, uintptr_t b) {
+    TCB *pTask = NextTask;
+    if (pTask->NotifyPending) {
+        *(uint *) a = pTask->nNotify;
+        pTask->nNotify = 0;
+        pTask->NotifyPending = FALSE;
+        pTask->NotifyStatus = OK;
+        return OK;
+    }
+    pTask->NotifyStatus = DEADLINE_REACHED;
+    if (time_reached(pTask->Deadline)) {
+        return OK;
+    }
+
+    pTask->pNotifyValue = (uint *) a;
+    pTask->NotifyWait = TRUE;
+    listobj *node = list_remove_head(ReadyList);
+    TRACE(TRACE_BLOCK, pTask, 0);
+    list_insert_sort(WaitingList, node, cmp_tcb_deadline);
+    note_event(pTask->Deadline);
+    NextTask = ReadyList->pHead->pTask;
+    return OK;
+}
+
+/* Sets the parameters the policies other than EDF schedule the calling
+   task by: under POLICY_RM nPeriod is its fixed priority, under POLICY_DM
+   nRelDeadline, and under POLICY_LLF nWcet is the time each job needs,
+   counted from set_deadline(). A smaller value runs first. */
+exception set_task_params(uint nPeriod, uint nRelDeadline, uint nWcet) {
+    uint arg[3];
+    arg[0] = nPeriod;
+    arg[1] = nRelDeadline;
+    arg[2] = nWcet;
+    return (exception) enter_kernel(SYS_SET_TASK_PARAMS, (uintptr_t) arg, 0);
+}
+
+static uintptr_t sys_set_task_params(uintptr_t a, uintptr_t b) {
+    uint *arg = (uint *) a;
+    NextTask->nPriority = (KERNEL_POLICY == POLICY_RM) ? arg[0] : arg[1];
+    NextTask->nWcet = arg[2];
+    ready_insert(ReadyList, list_remove_head(ReadyList));
+    NextTask = ReadyList->pHead->pTask;
+    return OK;
+}
+
+/* Sets the preemption threshold of the calling task, see schedPolicy.h.
+   Lowering it lets a task it held back run now. */
+exception set_preemption_threshold(uint nThreshold) {
+    return (exception) enter_kernel(SYS_SET_THRESHOLD, nThreshold, 0);
+}
+
+static uintptr_t sys_set_threshold(uintptr_t a, uintptr_t b) {
+    listobj *node = ReadyList->pHead;
+    NextTask->nThreshold = (uint) a;
+    if (node->pNext != NULL && ready_preempts(ReadyList, node->pNext->pTask)) {
+        ready_insert(ReadyList, list_remove_head(ReadyList));
+        NextTask = ReadyList->pHead->pTask;
+    }
+    return OK;
+}
+
+/* Gives the CPU to the next ready task if its key is no later than the
+   caller's, behind all tasks with the same key, so tasks with equal keys
+   take turns. Without such a task it returns without a kernel call: the
+   ReadyList is read unlocked, and a stale read only costs a needless trap
+   or misses a task readied at that moment, which then waits its turn. */
+void yield(void) {
+    listobj *next;
+    if (KernelMode != RUNNING) {
+        return;
+    }
+    next = NextTask->pNode->pNext;
+    if (next != NULL && !key_before(sched_key(NextTask), sched_key(next->pTask))) {
+        enter_kernel(SYS_YIELD, 0, 0);
+    }
+}
+
+static uintptr_t sys_yield(uintptr_t a, uintptr_t b) {
+    ready_requeue(ReadyList, list_remove_head(ReadyList));
+    NextTask = ReadyList->pHead->pTask;
+    return OK;
+}
+
+/* Selects what TimerInt does when the calling task overruns its deadline:
+   - MISS_SKIP and MISS_ABORT advance the deadline by nPeriod ticks.
+   - MISS_ABORT restarts the task in handler on a clean stack.
+*/
+exception set_miss_policy(action policy, uint nPeriod, void (*handler)()) {
+    if (policy < MISS_CONTINUE || policy > MISS_DEMOTE) {
+        return FAIL;
+    }
+    if ((policy == MISS_SKIP || policy == MISS_ABORT) && nPeriod == 0) {
+        return FAIL;
+    }
+    if (policy == MISS_ABORT && handler == NULL) {
+        return FAIL;
+    }
+    uint state = critical_enter();
+    NextTask->MissPolicy = policy;
+    NextTask->nPeriod = nPeriod;
+    NextTask->MissHandler = handler;
+    critical_exit(state);
+    return OK;
+}
+
+uint missed_deadlines(void) {
+    return NextTask->nMissed;
+}
+
+uint overrun_ticks(void) {
+    return NextTask->nOverrun;
+}
+
+/* A blocked task released by its deadline no longer waits for a
+   notification, a message or a reply; a late notify(), message or
+   reply_wait() leaves it alone, and the server it was blocked on stops
+   inheriting its deadline. Its mailbox entry stays until it runs, but
+   drop_stale() skips it. */
+static void cancel_waits(TCB *task) {
+    mailbox *mBox = task->pBlockBox;
+    task->NotifyWait = FALSE;
+    task->pBlockBox = NULL;
+    if (task->InCall) {
+        task->InCall = FALSE;
+        if (task->pServer != NULL) {
+            task->pServer->pTask->pClient = NULL;
+            task->pServer = NULL;
+        }
+    }
+    inherit_deadline(mBox);
+}
+
+static void count_miss(TCB *task) {
+    if (!task->Missed) {
+        task->Missed = TRUE;
+        task->nMissed++;
+    }
+}
+
+/* Applies the miss policy of the running task, which is the head of the
+   ReadyList. Runs inside TimerBottomHalf. */
+static void handle_overrun(TCB *task) {
+    task->nOverrun++;
+    count_miss(task);
+
+    switch (task->MissPolicy) {
+    case MISS_SKIP:
+        task->Deadline = time_valid(task->Deadline + task->nPeriod);
+        break;
+    case MISS_ABORT:
+        task->Deadline = time_valid(task->Deadline + task->nPeriod);
+        init_stack_frame(task, task->MissHandler);
+        break;
+    case MISS_DEMOTE:
+        task->Deadline = DEMOTED_DEADLINE;
+        break;
+    default:
+        return;     // MISS_CONTINUE
+    }
+    task->Missed = FALSE;
+    ready_insert(ReadyList, list_remove_head(ReadyList));
+}
+
+/* Kernel calls, in the order of the SYS_ numbers */
+static const sys_function SyscallTable[SYS_COUNT] = {
+    sys_create_task,
+    sys_terminate,
+    sys_send_wait,
+    sys_receive_wait,
+    sys_send_no_wait,
+    sys_receive_no_wait,
+    sys_drop_message,
+    sys_wait,
+    sys_set_deadline,
+    sys_notify,
+    sys_wait_notification,
+    sys_call,
+    sys_reply_wait,
+    sys_set_task_params,
+    sys_set_threshold,
+    sys_yield,
+    sys_hires_time,
+#if JOB_QUEUE_SIZE > 0
+    sys_submit_job,
+    sys_take_job,
+#endif
+#if KERNEL_HANDLERS
+    sys_create_handler,
+    sys_activate,
+    sys_set_handler_timer,
+    sys_next_handler,
+#endif
+};
+
+/* Called by the port in handler mode for every kernel_call(). The kernel
+   call runs atomically; when it leaves NextTask different from the
+   caller the port switches to NextTask on the way out, without saving
+   the caller's context if PreviousTask is NULL. */
+uintptr_t kernel_dispatch(uint nr, uintptr_t a, uintptr_t b) {
+    uintptr_t result;
+    if (nr >= SYS_COUNT) {
+        return FAIL;
+    }
+    PreviousTask = NextTask;
+    InKernelCall = TRUE;
+    mask_begin("kernel_call", nr);
+    result = SyscallTable[nr](a, b);
+    mask_end();
+    InKernelCall = FALSE;
+    return result;
+}
+
+/* Tasks trap into the kernel once per call. Before run() main() is the
+   only thread, so it runs the kernel call directly. Interrupt handlers
+   cannot trap either: they run it in a critical section, which holds off
+   the other interrupt handlers allowed to call the kernel, see critical.h. */
+static uintptr_t enter_kernel(uint nr, uintptr_t a, uintptr_t b) {
+    uintptr_t result;
+    uint state;
+    if (KernelMode != RUNNING) {
+        return SyscallTable[nr](a, b);
+    }
+    if (handler_mode()) {
+        state = critical_enter();
+        result = SyscallTable[nr](a, b);
+        critical_exit(state);
+        return result;
+    }
+    return kernel_call(nr, a, b);
+}
+
+/* TRUE if the time slice of the running task is used up and a task with
+   the same key is ready behind it */
+#if TIME_SLICE_TICKS > 0
+static bool slice_expired(void) {
+    listobj *next = NextTask->pNode->pNext;
+    return nSliceUsed >= TIME_SLICE_TICKS && next != NULL &&
+           sched_key(next->pTask) == sched_key(NextTask);
+}
+#endif
+
+/* Tick interrupt, top half: constant work. Advances the time and pends
+   the bottom half when a timer, a deadline, an overrun, the end of a
+   time slice or, under POLICY_LLF, a task with less laxity is due. */
 void TimerInt(void) {
-    Ticks++;
+    cpu_tick_begin();
+    mask_tick_entry();
+    mask_begin("TimerInt", 0);
+    if (++Ticks == 0) {
+        nTickWraps++;
+    }
     if (Ticks == 1000) {
         asm("nop");
     }
+
+#if TIME_SLICE_TICKS > 0
+    if (NextTask != SliceTask) {
+        SliceTask = NextTask;
+        nSliceUsed = 0;
+    }
+    nSliceUsed++;
+    if (slice_expired()) {
+        request_bottom_half();
+    }
+#endif
+    
+#if KERNEL_POLICY == POLICY_LLF
+    // The running task's laxity stays, the waiting tasks' shrinks
+    if (ReadyList->pHead->pTask == NextTask) {
+        NextTask->nUsed++;
+        if (ready_overtaken(ReadyList)) {
+            request_bottom_half();
+        }
+    }
+#endif
+
+    if (time_reached(NextEvent) || time_reached(NextTask->Deadline)) {
+        request_bottom_half();
+    }
+    mask_end();
+    cpu_tick_end();
+}
+
+/* Tick interrupt, bottom half: moves the expired tasks to the ReadyList.
+   Runs at the tick priority after all other interrupts have returned, with
+   the running task's context saved (PendSV on the target). The list work
+   is a critical section: only interrupt handlers that do not call the
+   kernel can preempt it. */
+void TimerBottomHalf(void) {
+    uint state;
+    mask_begin("TimerBottomHalf", 0);
+    state = critical_enter();
+
+    // The interrupted task is the running one; check it for an overrun first,
+    // unless an interrupt handler has just readied a more urgent task. An
+    // inherited deadline is a client's: the client times out below.
+    if (time_reached(NextTask->Deadline) && !NextTask->Inherits &&
+        ReadyList->pHead->pTask == NextTask) {
+        handle_overrun(NextTask);
+    }
+
+#if KERNEL_POLICY == POLICY_LLF
+    if (ready_overtaken(ReadyList)) {
+        ready_insert(ReadyList, list_remove_head(ReadyList));
+    }
+#endif
+
+#if TIME_SLICE_TICKS > 0
+    // Round robin: the next task with the same key gets a fresh slice
+    if (ReadyList->pHead->pTask == NextTask && slice_expired()) {
+        ready_requeue(ReadyList, list_remove_head(ReadyList));
+        nSliceUsed = 0;
+    }
+#endif
     
     // Iterate through TimerList to find eligible nodes.
     listobj *node = TimerList->pHead;
     while (node != NULL) {
         listobj *next = node->pNext;  // Save next pointer before unlinking.
-        if (node->pTask->Deadline <= Ticks || node->nTCnt <= Ticks) {
+        uint nDeadline = own_deadline(node->pTask);
+        if (time_reached(nDeadline) || time_reached(node->nTCnt)) {
+            if (time_reached(nDeadline)) {
+                count_miss(node->pTask);
+            }
+            TRACE(TRACE_WAKEUP, node->pTask, time_reached(nDeadline));
             // Unlink the node from TimerList without freeing it.
             node = list_unlink_node(TimerList, node);
             // Insert the node into ReadyList (using sorted insertion if desired).
-            list_insert_sort(ReadyList, node, cmp_tcb_priority);
-            PreviousTask = NextTask;
-            NextTask = node->pTask;
+            ready_insert(ReadyList, node);
         }
         node = next;
     }
     
     // Process WaitingList (which is sorted by deadline, so only the head is checked).
     while (WaitingList->pHead != NULL &&
-           WaitingList->pHead->pTask->Deadline <= Ticks) {
+           time_reached(WaitingList->pHead->pTask->Deadline)) {
         listobj *wnode = list_remove_head(WaitingList);
-        list_insert_sort(ReadyList, wnode, cmp_tcb_priority);
-        PreviousTask = NextTask;
-        NextTask = wnode->pTask;
+        cancel_waits(wnode->pTask);
+        count_miss(wnode->pTask);
+        TRACE(TRACE_WAKEUP, wnode->pTask, TRUE);
+        ready_insert(ReadyList, wnode);
+    }
+
+#if KERNEL_HANDLERS
+    handler_timers();
+#endif
+
+    // Next wake-up for the top half
+    NextEvent = NO_DEADLINE;
+    for (node = TimerList->pHead; node != NULL; node = node->pNext) {
+        note_event(node->pTask->nWakeBy);
+        note_event(node->pTask->Deadline);
     }
+    if (WaitingList->pHead != NULL) {
+        note_event(WaitingList->pHead->pTask->Deadline);
+    }
+#if KERNEL_HANDLERS
+    if (TimerHandlers != NULL) {
+        note_event(TimerHandlers->nTimer);
+    }
+#endif
+    
+    // Run whichever task now has the earliest deadline.
+    PreviousTask = NextTask;
+    NextTask = ReadyList->pHead->pTask;
+    critical_exit(state);
+    mask_end();
 }
 
+#if KERNEL_SWITCH_HOOK
+/* Called in handler mode by the context switch code after every run of
+   TimerBottomHalf and before loading the context of NextTask. */
+void switch_hook(void) {
+    cpu_account_switch();
+    trace_switch();
+}
+#endif
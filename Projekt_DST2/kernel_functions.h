@@ -9,9 +9,14 @@
 #include <stdlib.h>  /* for using the functions calloc, free */
 #include <string.h>  /* for using the function memcpy        */
 #include <limits.h>  /* for using the constant UINT_MAX      */
+#include <stdint.h>  /* for uintptr_t, the kernel call words */
+
+#include "kernel_config.h"
 
 #define CONTEXT_SIZE    8   /*  for the 8 registers: r4 to r11   */ 
+#ifndef STACK_SIZE
 #define STACK_SIZE      100 /*  about enough space for the stack */
+#endif
 
 
 #define TRUE    1
@@ -29,6 +34,27 @@
 
 #define SENDER          +1
 #define RECEIVER        -1
+#define CALLER          +2      /* a call() request, see reply_wait() */
+
+/* Deadline-miss policies, applied at the tick to a running task whose
+   deadline has expired */
+#define MISS_CONTINUE   0       /* keep running on the expired deadline     */
+#define MISS_SKIP       1       /* finish the job in the next period's slot */
+#define MISS_ABORT      2       /* restart the task in its miss handler     */
+#define MISS_DEMOTE     3       /* run only when nothing else is ready      */
+
+/* The two largest tick values are not times but sort after all of them,
+   see time_before() in compare.h */
+#define NO_DEADLINE             UINT_MAX        /* the idle task's          */
+#define DEMOTED_DEADLINE        (UINT_MAX - 1)
+
+/* Task notification actions, see notify() */
+#define NOTIFY_SET_BITS         0       /* OR the value into the word       */
+#define NOTIFY_INCREMENT        1       /* add the value to the word        */
+#define NOTIFY_OVERWRITE        2       /* replace the word with the value  */
+
+/* Preemption threshold that makes the running task non-preemptive */
+#define PREEMPT_NEVER           UINT_MAX
 
 typedef int             exception;
 typedef int             bool;
@@ -36,6 +62,8 @@ typedef unsigned int    uint;
 typedef int 		action;
 
 struct  l_obj;         // Forward declaration
+struct  hobj;
+struct  mbox;
 
 // Task Control Block, TCB.  Modified on 24/02/2019
 typedef struct
@@ -46,6 +74,35 @@ typedef struct
         uint    SPSR;     
         uint    StackSeg[STACK_SIZE];
         uint    Deadline;
+        bool    Missed;         /* current Deadline has been missed      */
+        uint    nMissed;        /* number of deadlines missed            */
+        uint    nOverrun;       /* ticks run past an expired deadline    */
+        action  MissPolicy;
+        uint    nPeriod;        /* deadline advance for MISS_SKIP/ABORT  */
+        void    (*MissHandler)();
+        struct l_obj *pNode;    /* its node in the task lists            */
+        uint    nNotify;        /* notification word, see notify()       */
+        bool    NotifyPending;  /* nNotify changed since it was taken    */
+        bool    NotifyWait;     /* blocked in wait_notification()        */
+        uint    *pNotifyValue;  /* where the blocked task takes nNotify  */
+        exception NotifyStatus; /* result of the blocked wait            */
+        bool    InCall;         /* blocked in call() for the reply       */
+        void    *pReply;        /* where call() takes the reply          */
+        exception CallStatus;   /* result of the blocked call()          */
+        struct l_obj *pServer;  /* serving this task's call()            */
+        struct l_obj *pClient;  /* whose call() this server is serving   */
+        uint    OwnDeadline;    /* Deadline before inheriting one        */
+        bool    Inherits;       /* Deadline inherited from a client      */
+        struct mbox *pBlockBox; /* mailbox it is blocked on              */
+        uint    nPriority;      /* fixed priority for POLICY_RM and _DM  */
+        uint    nWcet;          /* worst-case execution time for _LLF    */
+        uint    nUsed;          /* ticks run in the current job, _LLF    */
+        uint    nThreshold;     /* preemption threshold, in key units    */
+        uint    nSlack;         /* default timer slack of wait()         */
+        uint    nWakeBy;        /* latest tick its wait() may end        */
+#if KERNEL_CPU_STATS
+        unsigned long long nCycles;     /* CPU cycles run, see cpuUsage.h */
+#endif
 } TCB;
 
 
@@ -58,16 +115,45 @@ typedef struct msgobj {
         struct msgobj   *pNext;
 } msg;
 
+// Job for the job workers, see submit_job()
+typedef struct jobobj {
+        void            (*pFunction)(void *);
+        void            *pArg;
+        uint            Deadline;
+        struct jobobj   *pNext;
+} job;
+
 // Mailbox structure
-typedef struct {
+typedef struct mbox {
         msg             *pHead;
         msg             *pTail;
         int             nDataSize;
         int             nMaxMessages;
         int             nMessages;
         int             nBlockedMsg;
+        struct hobj     *pHandler;      /* activated by send_no_wait, or NULL */
+        bool            Server;         /* receiver inherits client deadlines */
+        struct l_obj    *pReceiver;     /* task that last received, if Server */
+        struct mbox     *pNextServer;   /* next server mailbox, if Server */
 } mailbox;
 
+// Run-to-completion handler, see create_handler()
+typedef struct hobj {
+        void            (*pFunction)(void *);
+        void            *pArg;
+        uint            nRelDeadline;   /* deadline of an activation, from its tick */
+        uint            Deadline;       /* of the earliest pending activation      */
+        uint            PendingDeadline[HANDLER_PENDING_MAX];
+                                        /* of each pending activation, a ring      */
+        uint            nFirstPending;  /* ring index of the earliest one          */
+        uint            nPending;       /* activations not run yet                 */
+        uint            nTimer;         /* tick of the next timer activation       */
+        uint            nPeriod;        /* timer period, 0 for a one-shot timer    */
+        bool            TimerArmed;
+        struct hobj     *pNextPending;
+        struct hobj     *pNextTimer;
+} handler;
+
 
 // Generic list item
 typedef struct l_obj {
@@ -94,11 +180,12 @@ exception       init_kernel(void);
 exception	create_task( void (* task_body)(), uint deadline);
 void            terminate( void );
 void            run( void );
+TCB*            current_task( void );
 
 extern list *ReadyList;
 extern list *WaitingList;
 extern list *TimerList;
-extern int Ticks;
+extern uint Ticks;
 extern int KernelMode;
 
 // Communication
@@ -109,21 +196,83 @@ exception       send_wait( mailbox* mBox, void* pData );
 exception       receive_wait( mailbox* mBox, void* pData );
 
 exception       remove_mailbox( mailbox* mBox);
+exception       set_server_mailbox( mailbox* mBox );
 
 exception	send_no_wait( mailbox* mBox, void* pData );
 int             receive_no_wait( mailbox* mBox, void* pData );
 
+// Request/reply: the request and the reply are both nDataSize bytes
+exception       call( mailbox* mBox, void* pRequest, void* pReply );
+exception       reply_wait( mailbox* mBox, void* pReply, void* pRequest );
+
 // Timing
 exception	wait( uint nTicks );
+exception       wait_slack( uint nTicks, uint nSlack );
+void            set_timer_slack( uint nSlack );
 void            set_ticks( uint nTicks );
 uint            ticks( void );
 uint		deadline( void );
 void            set_deadline( uint deadline );
 
+// High-resolution time, in SysTick (core clock) cycles since tick 0
+typedef unsigned long long hires;
+hires           hires_time( void );
+hires           ticks_to_hires( uint nTicks );
+uint            hires_to_ticks( hires t );
+void            set_deadline_hires( hires t );
+exception       wait_until_hires( hires t );
+
+// Task notifications: a 32-bit word per task, for one-to-one signalling
+// without a mailbox
+exception       notify( TCB *pTask, uint nValue, action eAction );
+exception       wait_notification( uint *pValue );
+
+// Job queue: a fixed set of worker tasks runs jobs in deadline order, each
+// at the deadline of its job
+#if JOB_QUEUE_SIZE > 0
+exception       start_job_workers( uint nWorkers );
+exception       submit_job( void (*pFunction)(void *), void *pArg, uint deadline );
+#endif
+
+// Run-to-completion handlers: short functions that never block, run one
+// at a time on a shared stack at the deadline of their activation
+#if KERNEL_HANDLERS
+handler*        create_handler( void (*pFunction)(void *), void *pArg, uint nRelDeadline );
+exception       activate( handler *pHandler );
+exception       set_handler_timer( handler *pHandler, uint nDelay, uint nPeriod );
+exception       bind_handler( mailbox *mBox, handler *pHandler );
+
+// Software timers: handlers activated only by their timer
+handler*        create_timer( void (*pCallback)(void *), void *pArg );
+exception       start_timer( handler *pTimer, uint nDelay, uint nPeriod );
+exception       stop_timer( handler *pTimer );
+#endif
+
+// Scheduling policy parameters, see schedPolicy.h
+exception       set_task_params( uint nPeriod, uint nRelDeadline, uint nWcet );
+exception       set_preemption_threshold( uint nThreshold );
+void            yield( void );
+uint            avoided_preemptions( void );
+
+// Deadline misses
+exception       set_miss_policy( action policy, uint nPeriod, void (*handler)() );
+uint            missed_deadlines( void );
+uint            overrun_ticks( void );
+
+// Kernel calls: task API calls trap once and run atomically in handler
+// mode, see kernel_dispatch() in kernel_functions.c
+typedef uintptr_t (*sys_function)( uintptr_t a, uintptr_t b );
+
+extern uintptr_t kernel_call( uint nr, uintptr_t a, uintptr_t b );  /* SVC #5 */
+uintptr_t       kernel_dispatch( uint nr, uintptr_t a, uintptr_t b );
+
 //Interrupt and context switch
 extern void     isr_off(void);
 extern void     isr_on(void);
 
+extern void     request_bottom_half( void );
+                   /* Pends TimerBottomHalf(), from the tick handler */
+
 extern void     SwitchContext( void );	
                    /* Stores stack frame in stack of currently running task, and the
                     * remaining registers in its TCB
@@ -206,3 +206,16 @@ listobj *list_first(list *lst) {
 listobj *list_next(listobj *node) {
     return (node) ? node->pNext : NULL;
 }
+
+void list_link_head(list *lst, listobj *node) {
+    if (!lst || !node)
+        return;
+
+    node->pPrevious = NULL;
+    node->pNext = lst->pHead;
+    if (lst->pHead)
+        lst->pHead->pPrevious = node;
+    else
+        lst->pTail = node;
+    lst->pHead = node;
+}
@@ -56,4 +56,7 @@ listobj *list_next(listobj *node);
 
 listobj *list_unlink_node(list *lst, listobj *node);
 
+/* Links the node itself in front of the head, for a node that sorts first.*/
+void list_link_head(list *lst, listobj *node);
+
 #endif /* LINKEDLIST_H */
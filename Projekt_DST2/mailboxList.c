@@ -47,3 +47,26 @@ msg *mailbox_remove_head(mailbox *mBox) {
     mBox->nMessages--;
     return message;
 }
+
+
+/**
+ * Removes a message from anywhere in the mailbox queue.
+ */
+void mailbox_unlink(mailbox *mBox, msg *message) {
+    if (!mBox || !message) return;
+
+    if (message->pPrevious) {
+        message->pPrevious->pNext = message->pNext;
+    } else {
+        mBox->pHead = message->pNext;
+    }
+    if (message->pNext) {
+        message->pNext->pPrevious = message->pPrevious;
+    } else {
+        mBox->pTail = message->pPrevious;
+    }
+    message->pNext = NULL;
+    message->pPrevious = NULL;
+
+    mBox->nMessages--;
+}
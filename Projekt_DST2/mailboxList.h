@@ -6,5 +6,6 @@
 // Function prototypes
 void mailbox_insert_tail(mailbox *mBox, msg *message);
 msg *mailbox_remove_head(mailbox *mBox);
+void mailbox_unlink(mailbox *mBox, msg *message);
 
 #endif
@@ -0,0 +1,100 @@
+#include "maskStats.h"
+
+#if KERNEL_MASK_STATS
+
+#include "cycleCounter.h"
+#include "critical.h"
+
+static mask_stats Site[MASK_STATS_SITES];
+static mask_stats TickLatency = { "SysTick", 0 };
+static int nSites = 0;
+static int nDepth = 0;                  /* nested mask_begin calls         */
+static mask_stats *Current = NULL;      /* site of the outermost begin     */
+static uint MaskStamp = 0;              /* cycle count at the outermost begin */
+
+static void record(mask_stats *pStats, uint nCycles) {
+    int bin = 0;
+    while (bin < MASK_HIST_BINS - 1 && (nCycles >> (bin + 1)) != 0) {
+        bin++;
+    }
+    pStats->aHistogram[bin]++;
+    pStats->nCount++;
+    if (nCycles > pStats->nMax) {
+        pStats->nMax = nCycles;
+    }
+}
+
+/* Sites beyond MASK_STATS_SITES share the last entry */
+static mask_stats *find_site(const char *pFile, int nLine) {
+    int i;
+    for (i = 0; i < nSites; i++) {
+        if (Site[i].pFile == pFile && Site[i].nLine == nLine) {
+            return &Site[i];
+        }
+    }
+    if (nSites == MASK_STATS_SITES) {
+        return &Site[MASK_STATS_SITES - 1];
+    }
+    Site[nSites].pFile = pFile;
+    Site[nSites].nLine = nLine;
+    return &Site[nSites++];
+}
+
+void mask_begin(const char *pFile, int nLine) {
+    if (nDepth++ == 0) {
+        Current = find_site(pFile, nLine);
+        MaskStamp = cycle_count();
+    }
+}
+
+void mask_end(void) {
+    if (nDepth > 0 && --nDepth == 0) {
+        record(Current, cycle_count() - MaskStamp);
+    }
+}
+
+/* Called first thing in TimerInt. Sys Tick went pending when its counter
+   reloaded, so the counter has run down by the latency since. */
+void mask_tick_entry(void) {
+    record(&TickLatency, systick_reload() - systick_count());
+}
+
+int mask_stats_snapshot(mask_stats *pStats, int nMax) {
+    int n;
+    uint state;
+    if (pStats == NULL) {
+        return 0;
+    }
+    state = critical_enter();
+    for (n = 0; n < nSites && n < nMax; n++) {
+        pStats[n] = Site[n];
+    }
+    critical_exit(state);
+    return n;
+}
+
+void tick_latency_stats(mask_stats *pStats) {
+    uint state = critical_enter();
+    *pStats = TickLatency;
+    critical_exit(state);
+}
+
+void mask_stats_reset(void) {
+    int i, k;
+    uint state = critical_enter();
+    for (i = 0; i < nSites; i++) {
+        Site[i].nCount = 0;
+        Site[i].nMax = 0;
+        for (k = 0; k < MASK_HIST_BINS; k++) {
+            Site[i].aHistogram[k] = 0;
+        }
+    }
+    TickLatency.nCount = 0;
+    TickLatency.nMax = 0;
+    for (k = 0; k < MASK_HIST_BINS; k++) {
+        TickLatency.aHistogram[k] = 0;
+    }
+    critical_exit(state);
+}
+
+#endif
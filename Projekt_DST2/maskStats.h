@@ -0,0 +1,52 @@
+#ifndef MASKSTATS_H
+#define MASKSTATS_H
+
+#include "kernel_functions.h"
+
+/* How long the kernel keeps the tick masked, and how late the tick runs.
+   Every stretch of masked time is timed with the cycle counter and charged
+   to the call site that started it:
+   - critical_enter() call sites, by file and line,
+   - kernel calls, as file "kernel_call" with the call number as line,
+   - TimerInt and TimerBottomHalf, the two halves of the tick.
+   The tick latency is the time from Sys Tick going pending to TimerInt
+   starting, read from the Sys Tick counter.
+   isr_off()/isr_on() in main() are not timed. With KERNEL_MASK_STATS set
+   to 0, the default, none of this is compiled. */
+
+#if KERNEL_MASK_STATS
+
+// Masked time of one call site, or the tick latency
+typedef struct {
+        const char      *pFile;
+        int             nLine;
+        uint            nCount;
+        uint            nMax;           /* cycles */
+        uint            aHistogram[MASK_HIST_BINS];
+                        /* bin k counts 2^k to 2^(k+1)-1 cycles, the last
+                           bin everything longer */
+} mask_stats;
+
+/* Fills pStats with up to nMax call sites, in order of first use. Returns
+   the number of entries written. */
+int                     mask_stats_snapshot( mask_stats *pStats, int nMax );
+
+/* Copies the tick latency statistics */
+void                    tick_latency_stats( mask_stats *pStats );
+
+void                    mask_stats_reset( void );
+
+// Kernel internal, privileged only
+void                    mask_begin( const char *pFile, int nLine );
+void                    mask_end( void );
+void                    mask_tick_entry( void );
+
+#else
+
+#define mask_begin(pFile, nLine)
+#define mask_end()
+#define mask_tick_entry()
+
+#endif
+
+#endif
@@ -0,0 +1,85 @@
+#include "schedPolicy.h"
+
+extern TCB *NextTask;
+
+static uint nAvoided = 0;       /* preemptions held back by a threshold */
+
+/* TRUE if head is the running task and its threshold holds back key */
+static bool held(const listobj *head, uint key) {
+    uint own;
+    if (head == NULL || head->pTask != NextTask) {
+        return FALSE;
+    }
+    own = sched_key(NextTask);
+    return !key_before(own, key) && (NextTask->nThreshold == PREEMPT_NEVER ||
+                          own - key < NextTask->nThreshold);
+}
+
+bool ready_preempts(list *lst, const TCB *task) {
+    uint key = sched_key(task);
+    return !key_before(sched_key(lst->pHead->pTask), key) && !held(lst->pHead, key);
+}
+
+#if KERNEL_POLICY == POLICY_LLF
+bool ready_overtaken(list *lst) {
+    listobj *next;
+    uint key;
+    if (lst->pHead == NULL || lst->pHead->pTask != NextTask ||
+        (next = lst->pHead->pNext) == NULL) {
+        return FALSE;
+    }
+    key = sched_key(next->pTask);
+    return key_before(key, sched_key(NextTask)) && !held(lst->pHead, key);
+}
+#endif
+
+uint avoided_preemptions(void) {
+    return nAvoided;
+}
+
+/* Links node in front of current, or at the tail if current is NULL */
+static void link_before(list *lst, listobj *current, listobj *node) {
+    node->pNext = current;
+    if (current == NULL) {
+        node->pPrevious = lst->pTail;
+        if (lst->pTail) {
+            lst->pTail->pNext = node;
+        } else {
+            lst->pHead = node;
+        }
+        lst->pTail = node;
+    } else {
+        node->pPrevious = current->pPrevious;
+        if (current->pPrevious) {
+            current->pPrevious->pNext = node;
+        } else {
+            lst->pHead = node;
+        }
+        current->pPrevious = node;
+    }
+}
+
+void ready_insert(list *lst, listobj *node) {
+    uint key = sched_key(node->pTask);
+    listobj *current = lst->pHead;
+
+    if (held(current, key)) {
+        nAvoided++;
+        current = current->pNext;
+    }
+
+    while (current != NULL && key_before(sched_key(current->pTask), key)) {
+        current = current->pNext;
+    }
+    link_before(lst, current, node);
+}
+
+void ready_requeue(list *lst, listobj *node) {
+    uint key = sched_key(node->pTask);
+    listobj *current = lst->pHead;
+
+    while (current != NULL && !key_before(key, sched_key(current->pTask))) {
+        current = current->pNext;
+    }
+    link_before(lst, current, node);
+}
@@ -0,0 +1,74 @@
+#ifndef SCHEDPOLICY_H
+#define SCHEDPOLICY_H
+
+#include "kernel_functions.h"
+#include "compare.h"
+
+/* Scheduling policy, selected at compile time with KERNEL_POLICY. The
+   ReadyList is kept sorted by sched_key(), smallest first, and its head
+   runs:
+   - POLICY_EDF: the absolute Deadline;
+   - POLICY_RM:  the period given to set_task_params(), rate monotonic;
+   - POLICY_DM:  the relative deadline given to set_task_params(),
+                 deadline monotonic;
+   - POLICY_LLF: least laxity first. The laxity at time t is Deadline - t
+                 minus the time the job still needs, the WCET given to
+                 set_task_params() less the ticks it has run since
+                 set_deadline(). t is the same for every task, so the key
+                 leaves it out. Only the running task's key changes, one
+                 step per tick; a task passes it when its key is strictly
+                 lower, so equal laxities do not switch every tick.
+   Until set_task_params() is called the fixed priority of RM and DM is
+   the relative deadline passed to create_task(). Job workers and the
+   handler dispatcher are created with the current tick as deadline, so
+   under RM and DM they run above every task.
+   Deadlines keep their meaning under every policy: misses, the tick, the
+   WaitingList order and deadline inheritance all use Deadline.
+
+   Preemption threshold: the running task keeps the head of the ReadyList
+   against a readied task unless that task's key is at least nThreshold
+   below its own; such a task is queued right behind it. The default 0
+   preempts on equal keys, as before; PREEMPT_NEVER makes the task
+   non-preemptive until it blocks or changes its deadline. A task passed
+   over by a preemption that did beat its threshold stays ahead of the
+   tasks it held back. */
+
+static inline uint sched_key(const TCB *task) {
+#if KERNEL_POLICY == POLICY_RM || KERNEL_POLICY == POLICY_DM
+    return task->nPriority;
+#elif KERNEL_POLICY == POLICY_LLF
+    uint nLeft = (task->nUsed < task->nWcet) ? task->nWcet - task->nUsed : 0;
+    return (task->Deadline >= DEMOTED_DEADLINE) ? task->Deadline
+                                                : time_valid(task->Deadline - nLeft);
+#else
+    return task->Deadline;
+#endif
+}
+
+/* TRUE if key a runs before key b: EDF and LLF keys are times */
+static inline bool key_before(uint a, uint b) {
+#if KERNEL_POLICY == POLICY_RM || KERNEL_POLICY == POLICY_DM
+    return a < b;
+#else
+    return time_before(a, b);
+#endif
+}
+
+/* Sorted insert into the ReadyList, in front of the tasks with the same
+   key; compares sched_key() inline instead of calling a cmp function.
+   Behind the running task if its threshold holds the node back. */
+void    ready_insert( list *lst, listobj *node );
+
+/* Sorted insert behind the tasks with the same key, for yield() */
+void    ready_requeue( list *lst, listobj *node );
+
+/* TRUE if task would go to the head of the ReadyList */
+bool    ready_preempts( list *lst, const TCB *task );
+
+#if KERNEL_POLICY == POLICY_LLF
+/* TRUE if the running task heads the ReadyList and the task behind it now
+   has less laxity, by more than the running task's threshold */
+bool    ready_overtaken( list *lst );
+#endif
+
+#endif
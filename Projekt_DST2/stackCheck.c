@@ -0,0 +1,122 @@
+#include "stackCheck.h"
+
+#if KERNEL_STACK_CHECK
+
+#include "critical.h"
+
+extern TCB *NextTask;
+
+static TCB *OverflowTask = NULL;
+static uint LastScan = UINT_MAX;         /* tick of the last idle scan step  */
+static int nScan = 0;                   /* index of the next task to check  */
+
+/* Called by create_task() before the initial frame is built; the frame
+   itself sits above the initial SP and is not painted. A stack recycled
+   from the task pool is still painted below its old high-water mark, so
+   only the words above it are painted again. */
+void stack_paint(TCB *task) {
+    int i = 0;
+    while (i < STACK_SIZE - 9 && task->StackSeg[i] == STACK_PAINT) {
+        i++;
+    }
+    for (; i < STACK_SIZE - 9; i++) {
+        task->StackSeg[i] = STACK_PAINT;
+    }
+}
+
+static uint peak(TCB *task) {
+    int i = 0;
+    while (i < STACK_SIZE && task->StackSeg[i] == STACK_PAINT) {
+        i++;
+    }
+    return STACK_SIZE - i;
+}
+
+static bool guard_broken(TCB *task) {
+    return task->StackSeg[0] != STACK_PAINT;
+}
+
+uint stack_peak(void) {
+    return peak(NextTask);
+}
+
+bool stack_overflowed(void) {
+    return guard_broken(NextTask);
+}
+
+TCB *stack_overflow_task(void) {
+    return OverflowTask;
+}
+
+void stack_forget(TCB *task) {
+    if (OverflowTask == task) {
+        OverflowTask = NULL;
+    }
+}
+
+static int collect(list *lst, stack_usage *pUsage, int n, int nMax) {
+    listobj *node = lst->pHead;
+    while (node != NULL && n < nMax) {
+        pUsage[n].pTask = node->pTask;
+        pUsage[n].nPeak = peak(node->pTask);
+        pUsage[n].Overflow = guard_broken(node->pTask);
+        n++;
+        node = node->pNext;
+    }
+    return n;
+}
+
+int stack_usage_snapshot(stack_usage *pUsage, int nMax) {
+    int n = 0;
+    uint state;
+    if (pUsage == NULL) {
+        return 0;
+    }
+    state = critical_enter();
+    n = collect(ReadyList, pUsage, n, nMax);
+    n = collect(WaitingList, pUsage, n, nMax);
+    n = collect(TimerList, pUsage, n, nMax);
+    critical_exit(state);
+    return n;
+}
+
+static listobj *nth(list *lst, int *pIndex) {
+    listobj *node = lst->pHead;
+    while (node != NULL && *pIndex > 0) {
+        node = node->pNext;
+        (*pIndex)--;
+    }
+    return node;
+}
+
+/* Called from the idle loop: checks the guard word of one task per tick,
+   going round all tasks in list order. */
+void stack_idle_scan(void) {
+    int i;
+    uint state;
+    listobj *node;
+    if (Ticks == LastScan) {
+        return;
+    }
+    state = critical_enter();
+    LastScan = Ticks;
+    i = nScan;
+    node = nth(ReadyList, &i);
+    if (node == NULL) {
+        node = nth(WaitingList, &i);
+    }
+    if (node == NULL) {
+        node = nth(TimerList, &i);
+    }
+    if (node == NULL) {
+        nScan = 0;
+    } else {
+        nScan++;
+        if (OverflowTask == NULL && guard_broken(node->pTask)) {
+            OverflowTask = node->pTask;
+        }
+    }
+    critical_exit(state);
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef STACKCHECK_H
+#define STACKCHECK_H
+
+#include "kernel_functions.h"
+
+/* Stack high-water marks by stack painting.
+   create_task() fills the unused part of StackSeg with STACK_PAINT. The
+   stack grows down towards StackSeg[0], so the words still painted at the
+   bottom are the ones the task has never touched. StackSeg[0] is the guard
+   word: once it has been overwritten the task has used its whole stack and
+   has probably overflowed into the registers saved below it in the TCB.
+   The idle task checks one guard word per tick.
+   On the host port tasks run on host stacks and only the initial frame
+   shows up in StackSeg. With KERNEL_STACK_CHECK set to 0 none of this is
+   compiled. */
+
+#if KERNEL_STACK_CHECK
+
+#define STACK_PAINT     0xA5A5A5A5
+
+// Stack use of one task
+typedef struct {
+        TCB     *pTask;
+        uint    nPeak;          /* most words ever used, of STACK_SIZE */
+        bool    Overflow;       /* guard word overwritten              */
+} stack_usage;
+
+/* Fills pUsage with up to nMax entries, one per existing task including the
+   idle task. Returns the number of entries written. */
+int                     stack_usage_snapshot( stack_usage *pUsage, int nMax );
+
+/* Peak stack use of the calling task in words, and whether it overflowed */
+uint                    stack_peak( void );
+bool                    stack_overflowed( void );
+
+/* The first task the idle scan found with an overwritten guard word, NULL
+   if none; cleared when that task terminates. */
+TCB *                   stack_overflow_task( void );
+
+// Kernel internal
+void                    stack_paint( TCB *task );
+void                    stack_idle_scan( void );
+void                    stack_forget( TCB *task );
+
+#else
+
+#define stack_paint(task)
+#define stack_idle_scan()
+#define stack_forget(task)
+
+#endif
+
+#endif
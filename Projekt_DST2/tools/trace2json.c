@@ -0,0 +1,245 @@
+/* trace2json - converts a dump of the kernel trace log (TraceLog, see
+   kernelTrace.h) into Chrome trace event JSON, which chrome://tracing and
+   ui.perfetto.dev display as a timeline with one row per task.
+
+   Build on the host:  gcc -O2 -o trace2json trace2json.c
+   Usage:              trace2json [-f MHz] dump > trace.json
+
+   The dump is either the raw little-endian memory image of TraceLog or the
+   text file of hex words written by dumpTrace() in trace_dump.mac. -f sets
+   the core clock used to convert cycles to microseconds (default 84 MHz). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../traceFormat.h"
+
+#define MAX_TASKS       256
+
+typedef struct {
+        unsigned int    pTask;
+        unsigned int    nDeadline;
+        int             bCreated;       /* nDeadline is known */
+        int             bNamed;
+} task_info;
+
+static task_info Tasks[MAX_TASKS];
+static int nTasks = 0;
+static int bFirstEvent = 1;
+
+static unsigned int *load(const char *path, size_t *pWords) {
+    FILE *file = fopen(path, "rb");
+    unsigned char *pBytes = NULL;
+    unsigned int *pData;
+    size_t nBytes = 0, nAlloc = 0, i;
+
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    for (;;) {
+        if (nBytes == nAlloc) {
+            nAlloc = nAlloc ? 2 * nAlloc : 65536;
+            pBytes = realloc(pBytes, nAlloc + 1);
+            if (!pBytes) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+            }
+        }
+        size_t n = fread(pBytes + nBytes, 1, nAlloc - nBytes, file);
+        if (n == 0) break;
+        nBytes += n;
+    }
+    fclose(file);
+
+    pData = malloc((nBytes / 4 + 1) * sizeof(unsigned int));
+    if (!pData) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    if (nBytes >= 4 && (pBytes[0] | pBytes[1] << 8 | pBytes[2] << 16 |
+                        (unsigned int) pBytes[3] << 24) == TRACE_MAGIC) {
+        // raw memory image
+        for (i = 0; i < nBytes / 4; i++) {
+            pData[i] = pBytes[4*i] | pBytes[4*i+1] << 8 | pBytes[4*i+2] << 16 |
+                       (unsigned int) pBytes[4*i+3] << 24;
+        }
+        *pWords = nBytes / 4;
+    } else {
+        // text, one hex word per line
+        char *p = (char *) pBytes, *end;
+        pBytes[nBytes] = '\0';
+        *pWords = 0;
+        for (;;) {
+            unsigned long word = strtoul(p, &end, 16);
+            if (end == p) break;
+            pData[(*pWords)++] = (unsigned int) word;
+            p = end;
+        }
+    }
+    free(pBytes);
+    return pData;
+}
+
+static task_info *task(unsigned int pTask) {
+    int i;
+    for (i = 0; i < nTasks; i++) {
+        if (Tasks[i].pTask == pTask) return &Tasks[i];
+    }
+    if (nTasks == MAX_TASKS) {
+        fprintf(stderr, "more than %d tasks\n", MAX_TASKS);
+        exit(1);
+    }
+    Tasks[nTasks].pTask = pTask;
+    Tasks[nTasks].nDeadline = 0;
+    Tasks[nTasks].bCreated = 0;
+    Tasks[nTasks].bNamed = 0;
+    return &Tasks[nTasks++];
+}
+
+static void begin_event(void) {
+    printf(bFirstEvent ? "\n" : ",\n");
+    bFirstEvent = 0;
+}
+
+static void name_task(task_info *pInfo) {
+    if (pInfo->bNamed) return;
+    pInfo->bNamed = 1;
+    begin_event();
+    if (!pInfo->bCreated) {
+        printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+               "\"args\":{\"name\":\"task 0x%08x\"}}", pInfo->pTask, pInfo->pTask);
+    } else if (pInfo->nDeadline == 0xFFFFFFFF) {
+        printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+               "\"args\":{\"name\":\"idle\"}}", pInfo->pTask);
+    } else {
+        printf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+               "\"args\":{\"name\":\"task 0x%08x dl %u\"}}",
+               pInfo->pTask, pInfo->pTask, pInfo->nDeadline);
+    }
+}
+
+/* argName is printed as an address, except "deadline" */
+static void instant(const char *name, unsigned int pTask, double ts,
+                    const char *argName, unsigned int nArg) {
+    name_task(task(pTask));
+    begin_event();
+    printf("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+           "\"ts\":%.3f", name, pTask, ts);
+    if (argName && strcmp(argName, "deadline") == 0) {
+        printf(",\"args\":{\"%s\":%u}", argName, nArg);
+    } else if (argName) {
+        printf(",\"args\":{\"%s\":\"0x%08x\"}", argName, nArg);
+    }
+    printf("}");
+}
+
+int main(int argc, char *argv[]) {
+    double mhz = 84.0;
+    const char *path = NULL;
+    unsigned int *pData, nSize, nReload, nIndex, nFirst, i;
+    size_t nWords, base;
+    unsigned int running = 0;
+    double runningSince = 0, last = 0;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc) {
+            mhz = atof(argv[++arg]);
+        } else {
+            path = argv[arg];
+        }
+    }
+    if (path == NULL || mhz <= 0) {
+        fprintf(stderr, "usage: %s [-f MHz] dump > trace.json\n", argv[0]);
+        return 1;
+    }
+
+    pData = load(path, &nWords);
+    for (base = 0; base < nWords && pData[base] != TRACE_MAGIC; base++);
+    if (base + TRACE_HEADER_WORDS > nWords) {
+        fprintf(stderr, "%s: no trace log found\n", path);
+        return 1;
+    }
+    nSize = pData[base + 1];
+    nReload = pData[base + 2];
+    nIndex = pData[base + 3];
+    if (nSize == 0 || (nSize & (nSize - 1)) != 0 ||
+        base + TRACE_HEADER_WORDS + (size_t) nSize * TRACE_ENTRY_WORDS > nWords) {
+        fprintf(stderr, "%s: truncated or corrupt trace log\n", path);
+        return 1;
+    }
+    if (nReload == 0) {
+        nReload = 99999;    // run() was never reached, assume SysTick_Config(100000)
+    }
+    nFirst = (nIndex > nSize) ? nIndex - nSize : 0;
+
+    printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (i = nFirst; i != nIndex; i++) {
+        unsigned int *pEntry = &pData[base + TRACE_HEADER_WORDS +
+                                      (size_t) (i & (nSize - 1)) * TRACE_ENTRY_WORDS];
+        trace_entry e;
+        double cycles, ts;
+
+        e.nTicks = pEntry[0];
+        e.nCount = pEntry[1];
+        e.pTask = pEntry[2];
+        e.nArg = pEntry[3];
+
+        cycles = (double) e.nTicks * (nReload + 1.0);
+        if (TRACE_COUNT(e.nCount) != TRACE_NO_COUNT) {
+            cycles += nReload - TRACE_COUNT(e.nCount);
+        }
+        ts = cycles / mhz;
+        if (ts < last) {
+            ts = last;      // thread mode events only carry the tick
+        }
+        last = ts;
+
+        switch (TRACE_EVENT(e.nCount)) {
+        case TRACE_SWITCH:
+            if (running != 0) {
+                begin_event();
+                printf("{\"name\":\"running\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                       "\"ts\":%.3f,\"dur\":%.3f}", running, runningSince, ts - runningSince);
+            }
+            name_task(task(e.pTask));
+            running = e.pTask;
+            runningSince = ts;
+            break;
+        case TRACE_CREATE:
+            task(e.pTask)->nDeadline = e.nArg;
+            task(e.pTask)->bCreated = 1;
+            instant("create", e.pTask, ts, "deadline", e.nArg);
+            break;
+        case TRACE_TERMINATE:
+            instant("terminate", e.pTask, ts, NULL, 0);
+            break;
+        case TRACE_BLOCK:
+            if (e.nArg != 0) {
+                instant("block", e.pTask, ts, "mailbox", e.nArg);
+            } else {
+                instant("wait", e.pTask, ts, NULL, 0);
+            }
+            break;
+        case TRACE_UNBLOCK:
+            instant("unblock", e.pTask, ts, "mailbox", e.nArg);
+            break;
+        case TRACE_WAKEUP:
+            instant(e.nArg ? "wakeup (deadline)" : "wakeup", e.pTask, ts, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "skipping unknown event %u\n", TRACE_EVENT(e.nCount));
+            break;
+        }
+    }
+    if (running != 0 && last > runningSince) {
+        begin_event();
+        printf("{\"name\":\"running\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+               "\"ts\":%.3f,\"dur\":%.3f}", running, runningSince, last - runningSince);
+    }
+    printf("\n]}\n");
+    free(pData);
+    return 0;
+}
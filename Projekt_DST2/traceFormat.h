@@ -0,0 +1,34 @@
+#ifndef TRACEFORMAT_H
+#define TRACEFORMAT_H
+
+/* Layout of the kernel trace log. Shared by the kernel (kernelTrace.h) and
+   the host decoder (tools/trace2json.c), so only plain definitions here.
+   A log is the header words nMagic, nSize, nReload, nIndex followed by
+   nSize entries; all fields are little-endian 32-bit words. */
+
+#define TRACE_MAGIC             0x31435254  /* "TRC1" */
+#define TRACE_HEADER_WORDS      4
+#define TRACE_ENTRY_WORDS       4
+
+// Events, stored in the top byte of trace_entry.nCount
+#define TRACE_SWITCH            1   /* pTask starts running, nArg = previous task */
+#define TRACE_CREATE            2   /* nArg = deadline                            */
+#define TRACE_TERMINATE         3
+#define TRACE_BLOCK             4   /* on mailbox nArg, or in wait() if 0         */
+#define TRACE_UNBLOCK           5   /* released through mailbox nArg              */
+#define TRACE_WAKEUP            6   /* readied by the tick, nArg = deadline missed */
+
+#define TRACE_NO_COUNT          0x00FFFFFF  /* SysTick counter was not readable */
+
+#define TRACE_EVENT(nCount)     ((nCount) >> 24)
+#define TRACE_COUNT(nCount)     ((nCount) & TRACE_NO_COUNT)
+
+// One event
+typedef struct {
+        unsigned int    nTicks;     /* Ticks when the event was recorded     */
+        unsigned int    nCount;     /* event << 24 | SysTick counter value   */
+        unsigned int    pTask;      /* address of the TCB concerned          */
+        unsigned int    nArg;
+} trace_entry;
+
+#endif